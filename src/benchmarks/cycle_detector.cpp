@@ -0,0 +1,188 @@
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <span>
+#include <string>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "history/constraint.h"
+#include "history/dependencygraph.h"
+#include "history/history.h"
+#include "solver/pruner.h"
+#include "solver/solver.h"
+#include "utils/literal.h"
+#include "utils/toposort.h"
+#include "utils/trail_graph.h"
+
+/*
+ * Replays the edges the solver adds and removes while checking a history
+ * through each incremental cycle detection algorithm.
+ *
+ * usage: cycle_detector_bench <history.bincode>...
+ */
+
+namespace chrono = std::chrono;
+
+using checker::solver::EdgeEvent;
+using checker::utils::IncrementalCycleDetector;
+using checker::utils::OrderMaintenance;
+using checker::utils::PearceKelly;
+using checker::utils::TwoWaySearch;
+using std::vector;
+
+// the graph the solver keeps its fixed edges in
+using Graph = checker::utils::TrailGraph<uint32_t, std::monostate>;
+
+struct ReplayResult {
+  chrono::microseconds time;
+  size_t n_cycles = 0;
+};
+
+/*
+ * With `batched`, the edges of each CHECK are checked together, otherwise one
+ * by one up to the first cycle. Then each edge is only added to the graph
+ * right before it is checked, since PearceKelly's search relies on the
+ * edges in the graph being in order.
+ */
+template <typename Algorithm>
+static auto replay(const vector<EdgeEvent> &events, size_t num_vertices,
+                   bool batched) -> ReplayResult {
+  // room for every added edge at once
+  auto capacity = vector<std::pair<uint32_t, uint32_t>>{};
+  for (const auto &[type, from, to] : events) {
+    if (type == EdgeEvent::BASE || type == EdgeEvent::ADD) {
+      capacity.emplace_back(from, to);
+    }
+  }
+  auto graph = Graph{num_vertices, capacity};
+  for (const auto &[type, from, to] : events) {
+    if (type == EdgeEvent::BASE) {
+      graph.add_edge(from, to, {});
+    }
+  }
+
+  // the detector starts from the base layer, as the solver's does
+  auto detector = IncrementalCycleDetector<Graph, Algorithm>{graph};
+  auto added = vector<Graph::edge_descriptor>{};
+  auto first_unchecked = 0_uz;
+  auto pending = vector<std::pair<uint32_t, uint32_t>>{};  // if not batched
+  auto result = ReplayResult{};
+
+  auto start = chrono::steady_clock::now();
+  for (const auto &[type, from, to] : events) {
+    switch (type) {
+      case EdgeEvent::BASE:
+        break;
+      case EdgeEvent::ADD:
+        if (batched) {
+          added.emplace_back(graph.add_edge(from, to, {}));
+        } else {
+          pending.emplace_back(from, to);
+        }
+        break;
+      case EdgeEvent::CHECK: {
+        auto has_cycle = false;
+        if (batched) {
+          auto unchecked = std::span{added}.subspan(first_unchecked);
+          has_cycle = detector.check_add_edges(unchecked).has_value();
+        } else {
+          // the edges after the first cycle are added unchecked, as the
+          // solver backtracks over them anyway
+          for (auto [pending_from, pending_to] : pending) {
+            auto e = graph.add_edge(pending_from, pending_to, {});
+            added.emplace_back(e);
+            if (!has_cycle && detector.check_add_edge(e)) {
+              has_cycle = true;
+            }
+          }
+          pending.clear();
+        }
+        result.n_cycles += has_cycle;
+        first_unchecked = added.size();
+        break;
+      }
+      case EdgeEvent::REMOVE:
+        if (!pending.empty()) {
+          pending.pop_back();
+          break;
+        }
+        graph.remove_last_edge();
+        added.pop_back();
+        first_unchecked = std::min(first_unchecked, added.size());
+        break;
+    }
+  }
+  result.time = chrono::duration_cast<chrono::microseconds>(
+      chrono::steady_clock::now() - start);
+
+  return result;
+}
+
+static auto record(const char *path) -> vector<EdgeEvent> {
+  auto history = checker::history::parse_dbcop_flat_history(path);
+  auto dependency_graph = checker::history::known_graph_of(history);
+  auto constraints =
+      checker::history::constraints_of(history, dependency_graph);
+
+  auto events = vector<EdgeEvent>{};
+  if (checker::solver::prune_constraints(dependency_graph, constraints)) {
+    auto solver = checker::solver::Solver{dependency_graph, constraints};
+    solver.record_edges(events);
+    solver.solve();
+  }
+
+  return events;
+}
+
+auto main(int argc, char **argv) -> int {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::warning);
+
+  auto agree = true;
+  for (auto i = 1; i < argc; i++) {
+    auto events = vector<EdgeEvent>{};
+    try {
+      events = record(argv[i]);
+    } catch (const std::exception &e) {
+      std::cerr << argv[i] << ": " << e.what() << '\n';
+      return 1;
+    }
+
+    auto num_vertices = 0_uz;
+    for (const auto &[_, from, to] : events) {
+      num_vertices = std::max<size_t>({num_vertices, from + 1_uz, to + 1_uz});
+    }
+
+    std::cout << argv[i] << ": " << events.size() << " edge events\n";
+
+    auto results = vector<std::pair<std::string, ReplayResult>>{
+        {"pearce-kelly",
+         replay<PearceKelly<Graph>>(events, num_vertices, true)},
+        {"pearce-kelly (edge by edge)",
+         replay<PearceKelly<Graph>>(events, num_vertices, false)},
+        {"order-maintenance",
+         replay<OrderMaintenance<Graph>>(events, num_vertices, true)},
+        {"two-way-search",
+         replay<TwoWaySearch<Graph>>(events, num_vertices, true)},
+    };
+    for (const auto &[name, result] : results) {
+      std::cout << "  " << name << ": " << result.time.count() << "us, "
+                << result.n_cycles << " cycles\n";
+      agree = agree && result.n_cycles == results.front().second.n_cycles;
+    }
+  }
+
+  if (!agree) {
+    std::cerr << "cycle detectors disagree\n";
+    return 1;
+  }
+  return 0;
+}
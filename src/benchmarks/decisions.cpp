@@ -0,0 +1,98 @@
+#include <z3++.h>
+
+#include <boost/log/core.hpp>
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "history/constraint.h"
+#include "history/dependencygraph.h"
+#include "history/history.h"
+#include "solver/solver.h"
+
+/*
+ * Solves each history with Z3's own decisions and with topological
+ * decisions, and compares their conflicts and solve time. Constraints are not
+ * pruned, which leaves the search more to decide.
+ *
+ * usage: decisions_bench <history.bincode>...
+ */
+
+namespace chrono = std::chrono;
+
+using std::vector;
+
+struct SolveResult {
+  bool accept = true;
+  chrono::milliseconds time{};
+  size_t n_conflicts = 0;
+};
+
+static auto solve(const checker::history::DependencyGraph &dependency_graph,
+                  const vector<checker::history::Constraint> &constraints,
+                  bool topological_decisions) -> SolveResult {
+  auto solver = checker::solver::Solver{dependency_graph, constraints};
+  solver.set_topological_decisions(topological_decisions);
+
+  auto result = SolveResult{};
+  auto start = chrono::steady_clock::now();
+  result.accept = solver.solve();
+  result.time = chrono::duration_cast<chrono::milliseconds>(
+      chrono::steady_clock::now() - start);
+
+  auto stats = solver.solver.statistics();
+  for (auto i = 0U; i < stats.size(); i++) {
+    if (stats.key(i) == "conflicts" && stats.is_uint(i)) {
+      result.n_conflicts = stats.uint_value(i);
+    }
+  }
+
+  return result;
+}
+
+auto main(int argc, char **argv) -> int {
+  boost::log::core::get()->set_filter(boost::log::trivial::severity >=
+                                      boost::log::trivial::warning);
+
+  if (!checker::solver::Solver::supports_topological_decisions()) {
+    std::cout << "this Z3 has no decision callbacks, both runs use Z3's "
+                 "decisions\n";
+  }
+
+  auto agree = true;
+  for (auto i = 1; i < argc; i++) {
+    auto results = vector<std::pair<std::string, SolveResult>>{};
+    try {
+      auto history = checker::history::parse_dbcop_flat_history(argv[i]);
+      auto dependency_graph = checker::history::known_graph_of(history);
+      auto constraints =
+          checker::history::constraints_of(history, dependency_graph);
+      results.emplace_back("z3", solve(dependency_graph, constraints, false));
+      results.emplace_back("topological",
+                           solve(dependency_graph, constraints, true));
+    } catch (const std::exception &e) {
+      std::cerr << argv[i] << ": " << e.what() << '\n';
+      return 1;
+    }
+
+    std::cout << argv[i] << ":\n";
+    for (const auto &[name, result] : results) {
+      std::cout << "  " << name << ": " << result.time.count() << "ms, "
+                << result.n_conflicts << " conflicts, accept "
+                << std::boolalpha << result.accept << '\n';
+      agree = agree && result.accept == results.front().second.accept;
+    }
+  }
+
+  if (!agree) {
+    std::cerr << "decision heuristics disagree\n";
+    return 1;
+  }
+  return 0;
+}
@@ -1,153 +1,217 @@
 #include "constraint.h"
 
+#include <algorithm>
 #include <boost/log/trivial.hpp>
+#include <cstddef>
 #include <cstdint>
-#include <functional>
 #include <iostream>
 #include <iterator>
 #include <ostream>
 #include <ranges>
 #include <syncstream>
-#include <unordered_map>
-#include <unordered_set>
+#include <tuple>
 #include <utility>
 #include <vector>
 
 #include "dependencygraph.h"
 #include "history.h"
 #include "utils/literal.h"
-#include "utils/to_container.h"
+#include "utils/parallel.h"
 
-using checker::utils::to;
-using std::get;
 using std::pair;
-using std::unordered_map;
-using std::unordered_set;
 using std::vector;
-using std::ranges::subrange;
-using std::ranges::views::transform;
-
-static constexpr auto filter_write_event =
-    std::ranges::views::filter([](const auto &ev) {
-      return ev.type == checker::history::EventType::WRITE;
-    });
+using std::ranges::views::iota;
+
+namespace {
+
+/*
+ * One key of one edge of a constraint: if pair_from is ordered before
+ * pair_to, then there is a `type` dependency from->to on `key`.
+ */
+struct ConstraintKey {
+  uint32_t pair_from;
+  uint32_t pair_to;
+  checker::history::EdgeType type;
+  uint32_t from;
+  uint32_t to;
+  uint32_t key;
+
+  /*
+   * Groups keys by unordered transaction pair, then by direction, then by
+   * edge; WW edges sort before RW edges.
+   */
+  auto order() const {
+    return std::tuple{std::min(pair_from, pair_to),
+                      std::max(pair_from, pair_to),
+                      pair_from,
+                      type,
+                      from,
+                      to,
+                      key};
+  }
 
-static constexpr auto hash_txns_pair = [](const pair<int64_t, int64_t> &p) {
-  std::hash<int64_t> h;
-  return h(p.first) ^ h(p.second);
+  friend auto operator==(const ConstraintKey &, const ConstraintKey &)
+      -> bool = default;
 };
 
-static constexpr auto hash_edge_endpoint = [](const auto &t) {
-  auto [t1, t2, type] = t;
-  std::hash<int64_t> h;
-  return h(t1) ^ h(t2) ^ static_cast<decltype(h(t1))>(type);
-};
+}  // namespace
 
 namespace checker::history {
-auto constraints_of(const History &history, const DependencyGraph::SubGraph &wr)
+auto constraints_of(const History &history, const DependencyGraph &known_graph,
+                    size_t threads) -> vector<Constraint> {
+  return constraints_of(flatten(history), known_graph, threads);
+}
+
+auto constraints_of(const FlatHistory &history,
+                    const DependencyGraph &known_graph, size_t threads)
     -> vector<Constraint> {
-  auto write_txns_per_key = unordered_map<int64_t, unordered_set<int64_t>>{};
-  for (const auto &event : history.events() | filter_write_event) {
-    write_txns_per_key[event.key].emplace(event.transaction_id);
+  // transactions are visited in index order, so each list is sorted and a
+  // repeated write to a key only has to be compared with the last entry
+  auto write_txns_per_key = vector<vector<uint32_t>>(history.num_keys());
+  for (auto txn : history.transactions()) {
+    for (auto ev : history.transaction_events(txn)) {
+      auto &txns = write_txns_per_key[history.keys[ev]];
+      if (history.types[ev] == EventType::WRITE &&
+          (txns.empty() || txns.back() != txn)) {
+        txns.emplace_back(txn);
+      }
+    }
   }
 
-  auto edges_per_txn_pair = unordered_map<
-      pair<int64_t, int64_t>,
-      unordered_map<std::tuple<int64_t, int64_t, EdgeType>, vector<int64_t>,
-                    decltype(hash_edge_endpoint)>,
-      decltype(hash_txns_pair)>{};
-  for (const auto &[key, txns] : write_txns_per_key) {
-    for (auto it = txns.begin(); it != txns.end(); it++) {
-      for (const auto &txn2 : subrange(std::next(it), txns.end())) {
-        auto add_key = [&](int64_t txn1, int64_t txn2) {
-          edges_per_txn_pair[{txn1, txn2}][{txn1, txn2, EdgeType::WW}]
-              .emplace_back(key);
-        };
-
-        add_key(*it, txn2);
-        add_key(txn2, *it);
+  auto reads_from_per_key = vector<vector<pair<uint32_t, uint32_t>>>(
+      history.num_keys());
+  for (const auto &[write_txn, read_txn, edge] : known_graph.wr()) {
+    for (const auto &[type, key] : edge.get().keys) {
+      if (type == EdgeType::WR) {
+        reads_from_per_key[key].emplace_back(write_txn, read_txn);
       }
     }
   }
 
-  for (const auto &a : history.transactions()) {
-    for (auto b_id : wr.successors(a.id)) {
-      const auto &keys = wr.edge(a.id, b_id).value().get().keys;
-      for (const auto &key : keys) {
-        for (auto c_id : write_txns_per_key.at(key)) {
-          if (a.id == c_id || b_id == c_id) {
-            continue;
+  // each worker generates the keys of a share of the history keys into its
+  // own buffers, one per bucket of transaction pairs, so the buckets can
+  // then be sorted and grouped independently
+  threads = std::max<size_t>(threads, 1);
+  auto num_buckets = threads == 1 ? 1 : 4 * threads;
+  auto bucket_of = [&](uint32_t txn1, uint32_t txn2) {
+    return std::min(txn1, txn2) % num_buckets;
+  };
+  auto buffers = vector<vector<vector<ConstraintKey>>>(
+      threads, vector<vector<ConstraintKey>>(num_buckets));
+
+  utils::parallel_for(
+      history.num_keys(), threads,
+      [&](size_t key, size_t worker) {
+        auto emit = [&](uint32_t pair_from, uint32_t pair_to, EdgeType type,
+                        uint32_t from, uint32_t to) {
+          buffers[worker][bucket_of(pair_from, pair_to)].emplace_back(
+              ConstraintKey{
+                  .pair_from = pair_from,
+                  .pair_to = pair_to,
+                  .type = type,
+                  .from = from,
+                  .to = to,
+                  .key = static_cast<uint32_t>(key),
+              });
+        };
+
+        // any two writers of a key are ordered one way or the other
+        const auto &txns = write_txns_per_key[key];
+        for (auto i = 0_uz; i < txns.size(); i++) {
+          for (auto j = i + 1; j < txns.size(); j++) {
+            emit(txns[i], txns[j], EdgeType::WW, txns[i], txns[j]);
+            emit(txns[j], txns[i], EdgeType::WW, txns[j], txns[i]);
           }
+        }
 
-          edges_per_txn_pair[{a.id, c_id}][{b_id, c_id, EdgeType::RW}]
-              .emplace_back(key);
+        // if b reads from a and a is before another writer c, then b is
+        // before c
+        for (auto [a, b] : reads_from_per_key[key]) {
+          for (auto c : txns) {
+            if (c != a && c != b) {
+              emit(a, c, EdgeType::RW, b, c);
+            }
+          }
         }
-      }
+      },
+      16);
+
+  auto constraints_per_bucket = vector<vector<Constraint>>(num_buckets);
+  utils::parallel_for(num_buckets, threads, [&](size_t bucket, size_t) {
+    auto keys = vector<ConstraintKey>{};
+    for (auto &worker_buffers : buffers) {
+      auto &buffer = worker_buffers[bucket];
+      keys.insert(keys.end(), buffer.begin(), buffer.end());
+      buffer = {};
     }
-  }
 
-  auto constraints = vector<Constraint>{};
-  auto added_pairs =
-      unordered_set<pair<int64_t, int64_t>, decltype(hash_txns_pair)>{};
-  for (const auto &[p, v] : edges_per_txn_pair) {
-    auto [txn1, txn2] = p;
+    std::ranges::sort(keys, {}, &ConstraintKey::order);
+    keys.erase(std::ranges::unique(keys).begin(), keys.end());
 
-    if (added_pairs.contains({txn2, txn1})) {
-      continue;
-    }
-    added_pairs.emplace(txn1, txn2);
-
-    auto to_edge = [&](auto txn1, auto txn2) {
-      return transform([=](auto &&p) {
-        auto &&[t, keys] = p;
-        auto &&[from, to, type] = t;
-        return Constraint::Edge{
-            from,
-            to,
-            EdgeInfo{
-                .type = type,
-                .keys = std::move(keys),
-            },
-        };
+    auto &constraints = constraints_per_bucket[bucket];
+    for (auto it = keys.begin(); it != keys.end();) {
+      auto &c = constraints.emplace_back(Constraint{
+          .either_txn_id = std::min(it->pair_from, it->pair_to),
+          .or_txn_id = std::max(it->pair_from, it->pair_to),
       });
-    };
-    auto is_ww_edge = [](auto &&e) {
-      return std::get<2>(e).type == EdgeType::WW;
-    };
-
-    auto either_edges = edges_per_txn_pair.at({txn1, txn2})  //
-                        | to_edge(txn1, txn2)                //
-                        | to<vector<Constraint::Edge>>;
-    auto or_edges = edges_per_txn_pair[{txn2, txn1}]  //
-                    | to_edge(txn2, txn1)             //
-                    | to<vector<Constraint::Edge>>;
-    std::swap(either_edges.front(),
-              *std::ranges::find_if(either_edges, is_ww_edge));
-    std::swap(or_edges.front(), *std::ranges::find_if(or_edges, is_ww_edge));
-
-    constraints.emplace_back(Constraint{
-        .either_txn_id = txn1,
-        .or_txn_id = txn2,
-        .either_edges = either_edges,
-        .or_edges = or_edges,
-    });
+
+      for (; it != keys.end() &&
+             std::min(it->pair_from, it->pair_to) == c.either_txn_id &&
+             std::max(it->pair_from, it->pair_to) == c.or_txn_id;
+           it++) {
+        auto &edges =
+            it->pair_from == c.either_txn_id ? c.either_edges : c.or_edges;
+        if (edges.empty() || std::get<0>(edges.back()) != it->from ||
+            std::get<1>(edges.back()) != it->to ||
+            std::get<2>(edges.back()).type != it->type) {
+          edges.emplace_back(it->from, it->to, EdgeInfo{.type = it->type});
+        }
+        std::get<2>(edges.back()).keys.emplace_back(it->key);
+      }
+    }
+  });
+
+  auto constraints = vector<Constraint>{};
+  auto num_constraints = 0_uz;
+  for (const auto &bucket : constraints_per_bucket) {
+    num_constraints += bucket.size();
   }
+  constraints.reserve(num_constraints);
+  for (auto &bucket : constraints_per_bucket) {
+    std::ranges::move(bucket, std::back_inserter(constraints));
+  }
+
+  // independent of the number of buckets
+  std::ranges::sort(constraints, {}, [](const Constraint &c) {
+    return pair{c.either_txn_id, c.or_txn_id};
+  });
 
   BOOST_LOG_TRIVIAL(info) << "#constraints: " << constraints.size();
 
   return constraints;
 }
 
-auto operator<<(std::ostream &os, const Constraint &constraint)
-    -> std::ostream & {
+/*
+ * Print with the ids of `graph`, or with indices if it is null.
+ */
+static auto print_constraint(std::ostream &os, const Constraint &constraint,
+                             const DependencyGraph *graph) -> void {
   auto out = std::osyncstream{os};
-  auto print_cond = [&](const char *tag, int64_t first_id, int64_t second_id,
+  auto txn_id = [&](uint32_t txn) -> int64_t {
+    return graph ? graph->txn_id(txn) : txn;
+  };
+  auto print_cond = [&](const char *tag, uint32_t first_id, uint32_t second_id,
                         const vector<Constraint::Edge> &edges) {
-    out << tag << ' ' << first_id << "->" << second_id << ": ";
+    out << tag << ' ' << txn_id(first_id) << "->" << txn_id(second_id) << ": ";
 
     for (auto i = 0_uz; i < edges.size(); i++) {
       const auto &[from, to, info] = edges.at(i);
-      out << from << "->" << to << ' ' << info;
+      out << txn_id(from) << "->" << txn_id(to) << ' ';
+      if (graph) {
+        graph->print(out, info);
+      } else {
+        out << info;
+      }
       if (i != edges.size() - 1) {
         out << ", ";
       }
@@ -160,6 +224,17 @@ auto operator<<(std::ostream &os, const Constraint &constraint)
   print_cond("or", constraint.or_txn_id, constraint.either_txn_id,
              constraint.or_edges);
   out << '\n';
+}
+
+auto operator<<(std::ostream &os, const Constraint &constraint)
+    -> std::ostream & {
+  print_constraint(os, constraint, nullptr);
+  return os;
+}
+
+auto operator<<(std::ostream &os, const ConstraintWithIds &c)
+    -> std::ostream & {
+  print_constraint(os, c.constraint, &c.graph);
   return os;
 }
 
@@ -1,6 +1,7 @@
 #ifndef CHECKER_HISTORY_CONSTRAINT_H
 #define CHECKER_HISTORY_CONSTRAINT_H
 
+#include <cstddef>
 #include <cstdint>
 #include <iosfwd>
 #include <tuple>
@@ -11,11 +12,16 @@
 
 namespace checker::history {
 
+/**
+ * Transactions are dense transaction indices, see DependencyGraph, and
+ * either_txn_id < or_txn_id. The first edge of each side is the WW edge
+ * between the two transactions.
+ */
 struct Constraint {
-  using Edge = std::tuple<int64_t, int64_t, EdgeInfo>;
+  using Edge = std::tuple<uint32_t, uint32_t, EdgeInfo>;
 
-  int64_t either_txn_id;
-  int64_t or_txn_id;
+  uint32_t either_txn_id;
+  uint32_t or_txn_id;
   std::vector<Edge> either_edges;
   std::vector<Edge> or_edges;
 
@@ -23,7 +29,29 @@ struct Constraint {
       -> std::ostream &;
 };
 
-auto constraints_of(const History &history, const DependencyGraph::SubGraph &wr)
+/**
+ * A constraint printed with the history's transaction and key ids, as kept
+ * by the dependency graph it was generated from:
+ *
+ *   os << ConstraintWithIds{c, dependency_graph}
+ */
+struct ConstraintWithIds {
+  const Constraint &constraint;
+  const DependencyGraph &graph;
+
+  friend auto operator<<(std::ostream &os, const ConstraintWithIds &c)
+      -> std::ostream &;
+};
+
+/**
+ * Generate the constraints of a history, splitting the work by key over
+ * `threads` threads.
+ */
+auto constraints_of(const History &history, const DependencyGraph &known_graph,
+                    size_t threads = 1) -> std::vector<Constraint>;
+
+auto constraints_of(const FlatHistory &history,
+                    const DependencyGraph &known_graph, size_t threads = 1)
     -> std::vector<Constraint>;
 
 }  // namespace checker::history
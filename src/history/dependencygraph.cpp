@@ -1,131 +1,262 @@
 #include "dependencygraph.h"
 
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/lookup_edge.hpp>
+#include <algorithm>
 #include <cstdint>
+#include <iterator>
+#include <numeric>
 #include <ostream>
 #include <ranges>
+#include <span>
+#include <sstream>
+#include <stdexcept>
 #include <syncstream>
-#include <unordered_map>
+#include <tuple>
 #include <utility>
+#include <vector>
 
 #include "history.h"
 #include "utils/literal.h"
 
-using boost::add_edge;
-using boost::add_vertex;
 using std::pair;
-using std::unordered_map;
-using std::ranges::views::filter;
+using std::tuple;
+using std::vector;
+using std::ranges::views::drop;
+using std::ranges::views::iota;
 
 namespace checker::history {
 
 auto known_graph_of(const History &history) -> DependencyGraph {
-  auto graph = DependencyGraph{};
-  auto transactions = unordered_map<int64_t, const Transaction *>{};
+  return known_graph_of(flatten(history));
+}
 
-  for (const auto &txn : history.transactions()) {
-    transactions.emplace(txn.id, &txn);
+auto known_graph_of(const FlatHistory &history) -> DependencyGraph {
+  // SO edges
+  auto edges = vector<tuple<uint32_t, uint32_t, TypedEdge>>{};
+  edges.reserve(history.num_transactions());
+  for (auto sess : iota(0_uz, history.num_sessions())) {
+    auto txns = history.session_transactions(sess);
+    for (auto txn : txns | drop(1)) {
+      edges.emplace_back(txn - 1, txn,
+                         TypedEdge{.types = edge_type_bit(EdgeType::SO)});
+    }
+  }
 
-    for (auto subgraph : {&graph.rw, &graph.so, &graph.wr, &graph.ww}) {
-      subgraph->add_vertex(txn.id);
+  // WR edges; the writers of each key are grouped by key and sorted by
+  // value, so a read finds its writer with a binary search
+  auto writes_offsets = vector<uint32_t>(history.num_keys() + 1);
+  for (auto ev : iota(0_uz, history.num_events())) {
+    if (history.types[ev] == EventType::WRITE) {
+      writes_offsets[history.keys[ev] + 1]++;
     }
   }
+  std::partial_sum(writes_offsets.begin(), writes_offsets.end(),
+                   writes_offsets.begin());
 
-  // add SO edges
-  for (const auto &sess : history.sessions) {
-    auto prev_txn = (const Transaction *){};
-    for (const auto &txn : sess.transactions) {
-      if (prev_txn) {
-        graph.so.add_edge(prev_txn->id, txn.id, EdgeInfo{.type = EdgeType::SO});
+  auto writes = vector<pair<int64_t, uint32_t>>(writes_offsets.back());
+  auto writes_end = writes_offsets;
+  for (auto txn : history.transactions()) {
+    for (auto ev : history.transaction_events(txn)) {
+      if (history.types[ev] == EventType::WRITE) {
+        writes[writes_end[history.keys[ev]]++] = {history.values[ev], txn};
       }
-
-      prev_txn = &txn;
     }
   }
 
-  // add WR edges
-  auto hash_pair = [](const pair<int64_t, int64_t> &p) {
-    return std::hash<int64_t>{}(p.first) ^ std::hash<int64_t>{}(p.second);
-  };
-  auto writes = std::unordered_map<pair<int64_t, int64_t>, const Transaction *,
-                                   decltype(hash_pair)>{};
-  auto filter_by_type = [](EventType t) {
-    return filter([=](const auto &ev) { return ev.type == t; });
+  auto writes_of_key = [&](uint32_t key) {
+    return std::span{writes}.subspan(
+        writes_offsets[key], writes_offsets[key + 1] - writes_offsets[key]);
   };
 
-  for (const auto &ev : history.events() | filter_by_type(EventType::WRITE)) {
-    writes.try_emplace({ev.key, ev.value}, transactions[ev.transaction_id]);
+  // stable, so that the first writer of a value wins
+  for (auto key : iota(0_uz, history.num_keys())) {
+    std::ranges::stable_sort(writes_of_key(key), {},
+                             &pair<int64_t, uint32_t>::first);
   }
 
-  for (const auto &ev : history.events() | filter_by_type(EventType::READ)) {
-    auto write_txn = writes[{ev.key, ev.value}];
-    auto txn = transactions.at(ev.transaction_id);
+  // (writer, reader, key) of every read of another transaction's write
+  auto reads_from = vector<tuple<uint32_t, uint32_t, uint32_t>>{};
+  for (auto txn : history.transactions()) {
+    for (auto ev : history.transaction_events(txn)) {
+      if (history.types[ev] != EventType::READ) {
+        continue;
+      }
 
-    if (write_txn == txn) {
-      continue;
-    }
+      auto key = history.keys[ev];
+      auto value = history.values[ev];
+      auto key_writes = writes_of_key(key);
+      auto it = std::ranges::lower_bound(key_writes, value, {},
+                                         &pair<int64_t, uint32_t>::first);
+      if (it == key_writes.end() || it->first != value) {
+        std::ostringstream os;
+        os << "Transaction " << history.txn_ids[txn] << " reads value "
+           << value << " of key " << history.key_ids[key]
+           << ", which is never written";
+        throw std::runtime_error{os.str()};
+      }
 
-    if (auto edge = graph.wr.edge(write_txn->id, txn->id); edge) {
-      edge.value().get().keys.emplace_back(ev.key);
-    } else {
-      graph.wr.add_edge(
-          write_txn->id, txn->id,
-          EdgeInfo{.type = EdgeType::WR, .keys = std::vector{ev.key}});
+      auto write_txn = it->second;
+      if (write_txn == txn) {
+        continue;
+      }
+
+      reads_from.emplace_back(write_txn, txn, key);
     }
   }
 
-  return graph;
-}
+  auto pair_of = [](const auto &e) {
+    return pair{std::get<0>(e), std::get<1>(e)};
+  };
 
-auto operator<<(std::ostream &os, const EdgeInfo &edge_info) -> std::ostream & {
-  auto out = std::osyncstream{os};
-  auto print_keys = [&] {
-    out << '(';
+  // one WR edge per (writer, reader) pair, with keys in the order read
+  std::ranges::stable_sort(reads_from, {}, pair_of);
 
-    const auto &keys = edge_info.keys;
-    for (auto i = 0_uz; i < keys.size(); i++) {
-      out << keys.at(i);
-      if (i != keys.size() - 1) {
-        out << ' ';
-      }
+  auto num_so_edges = edges.size();
+  for (const auto &[write_txn, txn, key] : reads_from) {
+    if (edges.size() == num_so_edges ||
+        pair_of(edges.back()) != pair{write_txn, txn}) {
+      edges.emplace_back(write_txn, txn,
+                         TypedEdge{.types = edge_type_bit(EdgeType::WR)});
     }
+    std::get<2>(edges.back()).keys.emplace_back(EdgeType::WR, key);
+  }
 
-    out << ')';
+  // merge the SO and WR edges between the same pair of transactions
+  std::ranges::stable_sort(edges, {}, pair_of);
+
+  auto num_edges = 0_uz;
+  for (auto i = 0_uz; i < edges.size(); i++) {
+    if (num_edges != 0 && pair_of(edges[num_edges - 1]) == pair_of(edges[i])) {
+      auto &edge = std::get<2>(edges[num_edges - 1]);
+      auto &other = std::get<2>(edges[i]);
+      edge.types |= other.types;
+      std::ranges::copy(other.keys, std::back_inserter(edge.keys));
+    } else if (num_edges++ != i) {
+      edges[num_edges - 1] = std::move(edges[i]);
+    }
+  }
+  edges.resize(num_edges);
+
+  return DependencyGraph{
+      .graph = DependencyGraph::Graph{history.num_transactions(),
+                                      std::move(edges)},
+      .txn_ids = history.txn_ids,
+      .key_ids = std::make_shared<const vector<int64_t>>(history.key_ids),
   };
+}
 
-  switch (edge_info.type) {
+auto TypedEdge::add(const EdgeInfo &info) -> void {
+  types |= edge_type_bit(info.type);
+  for (auto key : info.keys) {
+    keys.emplace_back(info.type, key);
+  }
+}
+
+auto DependencyGraph::add_edge(uint32_t from, uint32_t to,
+                               const EdgeInfo &info) -> void {
+  if (auto e = graph.edge(from, to); e) {
+    e.value().get().add(info);
+  } else {
+    graph.add_edge(from, to, TypedEdge{}).add(info);
+  }
+}
+
+static auto print_edge_type(std::ostream &os, EdgeType type) -> void {
+  switch (type) {
     case EdgeType::WW:
-      out << "WW";
-      print_keys();
+      os << "WW";
       break;
     case EdgeType::WR:
-      out << "WR";
-      print_keys();
+      os << "WR";
       break;
     case EdgeType::RW:
-      out << "RW";
-      print_keys();
+      os << "RW";
       break;
     case EdgeType::SO:
-      out << "SO";
+      os << "SO";
       break;
   }
+}
 
+static auto print_edge_info(std::ostream &os, const EdgeInfo &edge_info,
+                            auto &&key_id) -> void {
+  print_edge_type(os, edge_info.type);
+  if (edge_info.type != EdgeType::SO) {
+    os << '(';
+
+    const auto &keys = edge_info.keys;
+    for (auto i = 0_uz; i < keys.size(); i++) {
+      os << key_id(keys.at(i));
+      if (i != keys.size() - 1) {
+        os << ' ';
+      }
+    }
+
+    os << ')';
+  }
+}
+
+static auto print_typed_edge(std::ostream &os, const TypedEdge &edge,
+                             auto &&key_id) -> void {
+  auto first = true;
+  for (auto type : {EdgeType::SO, EdgeType::WR, EdgeType::WW, EdgeType::RW}) {
+    if (!edge.has(type)) {
+      continue;
+    }
+
+    if (!first) {
+      os << '+';
+    }
+    first = false;
+
+    print_edge_type(os, type);
+    if (type == EdgeType::SO) {
+      continue;
+    }
+
+    os << '(';
+    auto first_key = true;
+    for (const auto &[key_type, key] : edge.keys) {
+      if (key_type == type) {
+        os << (first_key ? "" : " ") << key_id(key);
+        first_key = false;
+      }
+    }
+    os << ')';
+  }
+}
+
+static constexpr auto same_key = [](uint32_t key) { return key; };
+
+auto DependencyGraph::print(std::ostream &os, const EdgeInfo &info) const
+    -> void {
+  print_edge_info(os, info, [this](uint32_t key) { return key_id(key); });
+}
+
+auto DependencyGraph::print(std::ostream &os, const TypedEdge &edge) const
+    -> void {
+  print_typed_edge(os, edge, [this](uint32_t key) { return key_id(key); });
+}
+
+auto operator<<(std::ostream &os, const EdgeInfo &edge_info) -> std::ostream & {
+  auto out = std::osyncstream{os};
+  print_edge_info(out, edge_info, same_key);
+  return os;
+}
+
+auto operator<<(std::ostream &os, const TypedEdge &edge) -> std::ostream & {
+  auto out = std::osyncstream{os};
+  print_typed_edge(out, edge, same_key);
   return os;
 }
 
 auto operator<<(std::ostream &os, const DependencyGraph &graph)
     -> std::ostream & {
   auto out = std::osyncstream{os};
-  out << "RW:\n"
-      << graph.rw << '\n'
-      << "WW:\n"
-      << graph.ww << '\n'
-      << "SO:\n"
-      << graph.so << '\n'
-      << "WR:\n"
-      << graph.wr << '\n';
+  for (const auto &[from, to, edge] : graph.edges()) {
+    out << graph.txn_id(from) << "->" << graph.txn_id(to) << ' ';
+    graph.print(out, edge.get());
+    out << '\n';
+  }
 
   return os;
 }
@@ -1,45 +1,132 @@
 #ifndef CHECKER_HISTORY_DEPENDENCYGRAPH_H
 #define CHECKER_HISTORY_DEPENDENCYGRAPH_H
 
-#include <array>
 #include <cstdint>
 #include <functional>
 #include <iosfwd>
+#include <memory>
 #include <optional>
 #include <ranges>
 #include <tuple>
-#include <unordered_map>
 #include <utility>
+#include <vector>
 
 #include "history.h"
 #include "utils/graph.h"
 
 namespace checker::history {
 
-enum class EdgeType { WW, RW, WR, SO };
+enum class EdgeType : uint8_t { WW, RW, WR, SO };
 
+/**
+ * A set of edge types, one bit per EdgeType.
+ */
+using EdgeTypes = uint8_t;
+
+constexpr auto edge_type_bit(EdgeType type) -> EdgeTypes {
+  return static_cast<EdgeTypes>(1u << static_cast<uint8_t>(type));
+}
+
+/**
+ * A single dependency, as found in constraints.
+ */
 struct EdgeInfo {
   EdgeType type;
-  std::vector<int64_t> keys;
+  std::vector<uint32_t> keys;
 
   friend auto operator<<(std::ostream &os, const EdgeInfo &edge_info)
       -> std::ostream &;
 };
 
+/**
+ * All dependencies from one transaction to another: the types present and
+ * the keys each of them is on.
+ */
+struct TypedEdge {
+  EdgeTypes types = 0;
+  std::vector<std::pair<EdgeType, uint32_t>> keys;
+
+  auto has(EdgeType type) const -> bool {
+    return types & edge_type_bit(type);
+  }
+
+  auto add(const EdgeInfo &info) -> void;
+
+  friend auto operator<<(std::ostream &os, const TypedEdge &edge)
+      -> std::ostream &;
+};
+
+/**
+ * Vertices are dense transaction indices of the FlatHistory the graph was
+ * built from, and edge keys are its dense key indices.
+ *
+ * There is one edge per ordered pair of transactions, carrying every type of
+ * dependency between them; the per-type views filter on the edge types.
+ * Edges found after construction (e.g. by the pruner) are merged into
+ * existing edges or land in the graph's overlay.
+ *
+ * txn_ids and key_ids map vertices and keys back to the history's own ids,
+ * which is what the graph is printed with; a graph without them prints its
+ * indices.
+ */
 struct DependencyGraph {
-  using SubGraph = utils::Graph<int64_t, EdgeInfo>;
+  using Graph = utils::Graph<uint32_t, TypedEdge>;
+
+  Graph graph;
+  std::vector<int64_t> txn_ids;
+  std::shared_ptr<const std::vector<int64_t>> key_ids;
 
-  SubGraph so;
-  SubGraph rw;
-  SubGraph wr;
-  SubGraph ww;
+  auto txn_id(uint32_t txn) const -> int64_t {
+    return txn < txn_ids.size() ? txn_ids[txn] : txn;
+  }
 
-  auto edges() const -> std::ranges::range auto{
-    return std::array{so.edges(), rw.edges(), wr.edges(), ww.edges()}  //
-           | std::ranges::views::join;
+  auto key_id(uint32_t key) const -> int64_t {
+    return key_ids && key < key_ids->size() ? (*key_ids)[key] : key;
   }
 
-  auto num_vertices() const -> size_t { return boost::num_vertices(*so.graph); }
+  /*
+   * Print an edge with the history's key ids.
+   */
+  auto print(std::ostream &os, const EdgeInfo &info) const -> void;
+  auto print(std::ostream &os, const TypedEdge &edge) const -> void;
+
+  auto add_edge(uint32_t from, uint32_t to, const EdgeInfo &info) -> void;
+
+  auto edge(uint32_t from, uint32_t to) const
+      -> std::optional<std::reference_wrapper<const TypedEdge>> {
+    return graph.edge(from, to);
+  }
+
+  auto successors(uint32_t v) const -> std::ranges::range auto{
+    return graph.successors(v);
+  }
+
+  auto successors(uint32_t v, EdgeType type) const -> std::ranges::range auto{
+    return graph.out_edges(v)  //
+           | std::ranges::views::filter([this, type](auto e) {
+               return graph.payload(e).has(type);
+             })  //
+           | std::ranges::views::transform(
+                 [this](auto e) { return graph.target(e); });
+  }
+
+  auto edges() const -> std::ranges::range auto{ return graph.edges(); }
+
+  auto edges(EdgeType type) const -> std::ranges::range auto{
+    return graph.edges()  //
+           | std::ranges::views::filter([type](const auto &e) {
+               return std::get<2>(e).get().has(type);
+             });
+  }
+
+  auto so() const -> std::ranges::range auto{ return edges(EdgeType::SO); }
+  auto wr() const -> std::ranges::range auto{ return edges(EdgeType::WR); }
+  auto ww() const -> std::ranges::range auto{ return edges(EdgeType::WW); }
+  auto rw() const -> std::ranges::range auto{ return edges(EdgeType::RW); }
+
+  auto num_vertices() const -> size_t { return graph.num_vertices(); }
+
+  auto num_edges() const -> size_t { return graph.num_edges(); }
 
   friend auto operator<<(std::ostream &os, const DependencyGraph &graph)
       -> std::ostream &;
@@ -47,6 +134,8 @@ struct DependencyGraph {
 
 auto known_graph_of(const History &history) -> DependencyGraph;
 
+auto known_graph_of(const FlatHistory &history) -> DependencyGraph;
+
 }  // namespace checker::history
 
 #endif /* CHECKER_HISTORY_DEPENDENCYGRAPH_H */
@@ -2,139 +2,330 @@
 
 #include <bits/ranges_algo.h>
 
+#include <algorithm>
+#include <array>
 #include <boost/endian.hpp>
 #include <boost/log/trivial.hpp>
 #include <cstdint>
+#include <cstring>
+#include <filesystem>
 #include <istream>
 #include <iterator>
+#include <limits>
 #include <numeric>
 #include <ostream>
 #include <ranges>
+#include <span>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <syncstream>
-#include <unordered_set>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "utils/literal.h"
+#include "utils/mmap.h"
 #include "utils/to_container.h"
 
-using std::ranges::count_if;
 using std::ranges::views::iota;
 using std::ranges::views::transform;
 
-static auto read_int64(std::istream &in) -> int64_t {
-  int64_t n;
-  in.read(reinterpret_cast<char *>(&n), sizeof(n));
-  boost::endian::little_to_native_inplace(n);
-  return n;
-}
+namespace {
+
+/**
+ * Bounds-checked little-endian decoder over an in-memory dbcop file.
+ */
+struct ByteReader {
+  std::span<const std::byte> bytes;
+  size_t offset = 0;
+
+  auto require(size_t n) const -> void {
+    if (n > bytes.size() - offset) {
+      std::ostringstream os;
+      os << "Truncated history: need " << n << " bytes at offset " << offset
+         << ", but only " << bytes.size() - offset << " left";
+      throw std::runtime_error{os.str()};
+    }
+  }
+
+  auto read_int64() -> int64_t {
+    require(sizeof(int64_t));
+    int64_t n;
+    std::memcpy(&n, bytes.data() + offset, sizeof(n));
+    offset += sizeof(n);
+    return boost::endian::little_to_native(n);
+  }
+
+  auto read_bool() -> bool {
+    require(1);
+    return bytes[offset++] != std::byte{0};
+  }
+
+  auto read_str() -> std::string_view {
+    auto size = read_size(1);
+    auto s = std::string_view{
+        reinterpret_cast<const char *>(bytes.data() + offset), size};
+    offset += size;
+    return s;
+  }
 
-static auto read_str(std::istream &in) -> std::string {
-  auto size = read_int64(in);
-  auto s = std::string(size, '\0');
-  in.read(s.data(), size);
-  return s;
+  // a length prefix, rejected if the remaining bytes cannot hold that many
+  // elements of at least min_element_size bytes each
+  auto read_size(size_t min_element_size) -> size_t {
+    auto prefix_offset = offset;
+    auto size = read_int64();
+    if (size < 0 ||
+        static_cast<uint64_t>(size) >
+            (bytes.size() - offset) / min_element_size) {
+      std::ostringstream os;
+      os << "Invalid length " << size << " at offset " << prefix_offset;
+      throw std::runtime_error{os.str()};
+    }
+
+    return static_cast<size_t>(size);
+  }
+};
+
+// IS_WRITE KEY VALUE SUCCESS
+constexpr size_t event_bytes = 1 + 8 + 8 + 1;
+// SIZE SUCCESS
+constexpr size_t txn_bytes = 8 + 1;
+// SIZE
+constexpr size_t session_bytes = 8;
+
+auto intern_key(checker::history::FlatHistory &history,
+                std::unordered_map<int64_t, uint32_t> &key_index, int64_t key)
+    -> uint32_t {
+  auto [it, inserted] = key_index.try_emplace(key, history.num_keys());
+  if (inserted) {
+    history.key_ids.emplace_back(key);
+  }
+
+  return it->second;
 }
 
-static auto read_bool(std::istream &in) -> bool { return in.get() != 0; }
+}  // namespace
 
 namespace checker::history {
 
-auto parse_dbcop_history(std::istream &is) -> History {
+auto parse_dbcop_flat_history(std::span<const std::byte> bytes)
+    -> FlatHistory {
   constexpr int64_t init_session_id = 0;
   constexpr int64_t init_txn_id = 0;
 
-  auto history = History{};
+  auto in = ByteReader{.bytes = bytes};
+  auto history = FlatHistory{};
   int64_t current_session_id = 1;
   int64_t current_txn_id = 1;
-  auto keys = std::unordered_set<int64_t>{};
+  auto key_index = std::unordered_map<int64_t, uint32_t>{};
 
-  auto parse_event = [&](Transaction &txn) {
-    auto is_write = read_bool(is);
-    auto key = read_int64(is);
-    auto value = read_int64(is);
-    auto success = read_bool(is);
+  auto parse_event = [&] {
+    auto is_write = in.read_bool();
+    auto key = in.read_int64();
+    auto value = in.read_int64();
+    auto success = in.read_bool();
 
     if (success) {
-      keys.insert(key);
-      txn.events.emplace_back(Event{
-          .key = key,
-          .value = value,
-          .type = is_write ? EventType::WRITE : EventType::READ,
-          .transaction_id = txn.id,
-      });
+      history.keys.emplace_back(intern_key(history, key_index, key));
+      history.values.emplace_back(value);
+      history.types.emplace_back(is_write ? EventType::WRITE : EventType::READ);
     }
   };
 
-  auto parse_txn = [&](Session &session) {
-    auto &txn = session.transactions.emplace_back(Transaction{
-        .id = current_txn_id++,
-        .session_id = session.id,
-    });
+  auto end_txn = [&](int64_t txn_id) {
+    if (history.num_events() > std::numeric_limits<uint32_t>::max()) {
+      throw std::runtime_error{"Too many events in history"};
+    }
+
+    history.txn_ids.emplace_back(txn_id);
+    history.txn_sessions.emplace_back(history.num_sessions());
+    history.txn_event_offsets.emplace_back(history.num_events());
+  };
+
+  auto end_session = [&](int64_t session_id) {
+    history.session_ids.emplace_back(session_id);
+    history.session_txn_offsets.emplace_back(history.num_transactions());
+  };
+
+  auto parse_txn = [&] {
+    auto txn_id = current_txn_id++;
 
-    auto size = read_int64(is);
-    for ([[maybe_unused]] auto i : iota(0, size)) {
-      parse_event(txn);
+    auto size = in.read_size(event_bytes);
+    for ([[maybe_unused]] auto i : iota(0_uz, size)) {
+      parse_event();
     }
 
-    auto success = read_bool(is);
-    if (!success) {
-      session.transactions.pop_back();
+    auto success = in.read_bool();
+    if (success) {
+      end_txn(txn_id);
+    } else {
+      // drop the events of an aborted transaction
+      auto committed_events_num = history.txn_event_offsets.back();
+      history.keys.resize(committed_events_num);
+      history.values.resize(committed_events_num);
+      history.types.resize(committed_events_num);
     }
   };
 
   auto parse_session = [&] {
-    auto &session =
-        history.sessions.emplace_back(Session{.id = current_session_id++});
+    auto session_id = current_session_id++;
 
-    auto size = read_int64(is);
-    for ([[maybe_unused]] auto i : iota(0, size)) {
-      parse_txn(session);
+    auto size = in.read_size(txn_bytes);
+    for ([[maybe_unused]] auto i : iota(0_uz, size)) {
+      parse_txn();
     }
+
+    end_session(session_id);
   };
 
-  [[maybe_unused]] auto id = read_int64(is);
-  [[maybe_unused]] auto session_num = read_int64(is);
-  [[maybe_unused]] auto key_num = read_int64(is);
-  [[maybe_unused]] auto txn_num = read_int64(is);
-  [[maybe_unused]] auto event_num = read_int64(is);
-  [[maybe_unused]] auto info = read_str(is);
-  [[maybe_unused]] auto start = read_str(is);
-  [[maybe_unused]] auto end = read_str(is);
-
-  auto size = read_int64(is);
-  for ([[maybe_unused]] auto i : iota(0, size)) {
+  [[maybe_unused]] auto id = in.read_int64();
+  auto session_num = in.read_int64();
+  auto key_num = in.read_int64();
+  auto txn_num = in.read_int64();
+  auto event_num = in.read_int64();
+  [[maybe_unused]] auto info = in.read_str();
+  [[maybe_unused]] auto start = in.read_str();
+  [[maybe_unused]] auto end = in.read_str();
+
+  auto size = in.read_size(session_bytes);
+  if (static_cast<int64_t>(size) != session_num) {
+    BOOST_LOG_TRIVIAL(warning) << "history header declares " << session_num
+                               << " sessions, but " << size << " are present";
+  }
+
+  // TXN_NUM and EVENT_NUM are the per-session and per-transaction sizes the
+  // history was generated with, so the columns can be reserved once up front.
+  // Each estimate is capped by what the remaining bytes could hold.
+  auto remaining = bytes.size() - in.offset;
+  auto estimate = [](int64_t n, size_t max) {
+    return n < 0 ? 0_uz : std::min(static_cast<size_t>(n), max);
+  };
+  auto keys_num = estimate(key_num, remaining / event_bytes);
+  auto txns_num =
+      size * estimate(txn_num, remaining / txn_bytes / std::max(size, 1_uz));
+  auto events_per_txn =
+      estimate(event_num, remaining / event_bytes / std::max(txns_num, 1_uz));
+  auto events_num = txns_num * events_per_txn + keys_num;
+
+  key_index.reserve(keys_num);
+  history.key_ids.reserve(keys_num);
+  history.keys.reserve(events_num);
+  history.values.reserve(events_num);
+  history.types.reserve(events_num);
+  history.txn_ids.reserve(txns_num + 1);
+  history.txn_sessions.reserve(txns_num + 1);
+  history.txn_event_offsets.reserve(txns_num + 2);
+  history.session_ids.reserve(size + 1);
+  history.session_txn_offsets.reserve(size + 2);
+
+  for ([[maybe_unused]] auto i : iota(0_uz, size)) {
     parse_session();
   }
 
-  history.sessions.emplace_back(Session{
-      .id = init_session_id,
-      .transactions = std::vector{Transaction{
-          .id = init_txn_id,
-          .events = keys  //
-                    | transform([](auto key) {
-                        return Event{
-                            .key = key,
-                            .value = 0,
-                            .type = EventType::WRITE,
-                            .transaction_id = init_txn_id,
-                        };
-                      })  //
-                    | utils::to<std::vector<Event>>,
-          .session_id = init_session_id,
-      }},
-  });
-
-  auto count_all = [](auto &&) { return true; };
-  BOOST_LOG_TRIVIAL(info) << "#sessions: " << history.sessions.size();
-  BOOST_LOG_TRIVIAL(info) << "#transactions: "
-                          << count_if(history.transactions(), count_all);
-  BOOST_LOG_TRIVIAL(info) << "#events: "
-                          << count_if(history.events(), count_all);
+  // the initial transaction writes every key, in a session of its own
+  for (auto key : iota(0_uz, history.num_keys())) {
+    history.keys.emplace_back(key);
+    history.values.emplace_back(0);
+    history.types.emplace_back(EventType::WRITE);
+  }
+  end_txn(init_txn_id);
+  end_session(init_session_id);
+
+  BOOST_LOG_TRIVIAL(info) << "#sessions: " << history.num_sessions();
+  BOOST_LOG_TRIVIAL(info) << "#transactions: " << history.num_transactions();
+  BOOST_LOG_TRIVIAL(info) << "#events: " << history.num_events();
+  BOOST_LOG_TRIVIAL(info) << "#keys: " << history.num_keys();
 
   return history;
 }
 
+auto parse_dbcop_flat_history(const std::filesystem::path &path)
+    -> FlatHistory {
+  auto file = utils::MappedFile{path};
+  return parse_dbcop_flat_history(file.bytes());
+}
+
+auto flatten(const History &history) -> FlatHistory {
+  auto flat = FlatHistory{};
+  auto key_index = std::unordered_map<int64_t, uint32_t>{};
+
+  auto events_num = std::ranges::distance(history.events());
+  flat.keys.reserve(events_num);
+  flat.values.reserve(events_num);
+  flat.types.reserve(events_num);
+  flat.session_ids.reserve(history.sessions.size());
+
+  for (const auto &session : history.sessions) {
+    for (const auto &txn : session.transactions) {
+      for (const auto &event : txn.events) {
+        flat.keys.emplace_back(intern_key(flat, key_index, event.key));
+        flat.values.emplace_back(event.value);
+        flat.types.emplace_back(event.type);
+      }
+
+      flat.txn_ids.emplace_back(txn.id);
+      flat.txn_sessions.emplace_back(flat.num_sessions());
+      flat.txn_event_offsets.emplace_back(flat.num_events());
+    }
+
+    flat.session_ids.emplace_back(session.id);
+    flat.session_txn_offsets.emplace_back(flat.num_transactions());
+  }
+
+  return flat;
+}
+
+auto parse_dbcop_history(std::span<const std::byte> bytes) -> History {
+  auto flat = parse_dbcop_flat_history(bytes);
+  auto history = History{};
+
+  history.sessions.reserve(flat.num_sessions());
+  for (auto s : iota(0_uz, flat.num_sessions())) {
+    auto &session = history.sessions.emplace_back(Session{
+        .id = flat.session_ids[s],
+    });
+
+    session.transactions.reserve(flat.session_transactions(s).size());
+    for (auto t : flat.session_transactions(s)) {
+      auto &txn = session.transactions.emplace_back(Transaction{
+          .id = flat.txn_ids[t],
+          .session_id = session.id,
+      });
+
+      txn.events = flat.transaction_events(t)  //
+                   | transform([&](auto e) {
+                       return Event{
+                           .key = flat.key_ids[flat.keys[e]],
+                           .value = flat.values[e],
+                           .type = flat.types[e],
+                           .transaction_id = txn.id,
+                       };
+                     })  //
+                   | utils::to<std::vector<Event>>;
+    }
+  }
+
+  return history;
+}
+
+auto parse_dbcop_history(std::istream &is) -> History {
+  auto bytes = std::vector<std::byte>{};
+  auto buffer = std::array<char, 1 << 16>{};
+  while (is.read(buffer.data(), buffer.size()) || is.gcount() > 0) {
+    auto begin = reinterpret_cast<const std::byte *>(buffer.data());
+    bytes.insert(bytes.end(), begin, begin + is.gcount());
+  }
+
+  return parse_dbcop_history(std::span{bytes});
+}
+
+auto parse_dbcop_history(const std::filesystem::path &path) -> History {
+  auto file = utils::MappedFile{path};
+  return parse_dbcop_history(file.bytes());
+}
+
 auto operator<<(std::ostream &os, const History &history) -> std::ostream & {
   auto out = std::osyncstream{os};
 
@@ -156,4 +347,27 @@ auto operator<<(std::ostream &os, const History &history) -> std::ostream & {
   return os;
 }
 
+auto operator<<(std::ostream &os, const FlatHistory &history)
+    -> std::ostream & {
+  auto out = std::osyncstream{os};
+
+  for (auto s : iota(0_uz, history.num_sessions())) {
+    out << "\nSession " << history.session_ids[s] << ":\n";
+
+    for (auto t : history.session_transactions(s)) {
+      out << "Txn " << history.txn_ids[t] << ": ";
+
+      for (auto e : history.transaction_events(t)) {
+        out << (history.types[e] == EventType::READ ? "R(" : "W(")
+            << history.key_ids[history.keys[e]] << ", " << history.values[e]
+            << "), ";
+      }
+
+      out << "\n";
+    }
+  }
+
+  return os;
+}
+
 }  // namespace checker::history
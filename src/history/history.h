@@ -3,14 +3,16 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <filesystem>
 #include <functional>
 #include <iosfwd>
 #include <ranges>
+#include <span>
 #include <vector>
 
 namespace checker::history {
 
-enum class EventType { READ, WRITE };
+enum class EventType : uint8_t { READ, WRITE };
 
 struct Event {
   int64_t key;
@@ -54,7 +56,64 @@ struct History {
 };
 
 /**
- * Read history from an input stream. The history is in dbcop format.
+ * A columnar (structure-of-arrays) history.
+ *
+ * Transactions are identified by a dense index in [0, num_transactions()),
+ * assigned in session order, and sessions by a dense index in
+ * [0, num_sessions()). The events of transaction t are the event columns in
+ * [txn_event_offsets[t], txn_event_offsets[t + 1]), and the transactions of
+ * session s are [session_txn_offsets[s], session_txn_offsets[s + 1]).
+ *
+ * Keys are interned to dense indices in [0, num_keys()) as well, so that
+ * everything downstream can use vectors indexed by key or transaction instead
+ * of hash tables. The original ids are kept in key_ids, txn_ids and
+ * session_ids.
+ */
+struct FlatHistory {
+  // event columns
+  std::vector<uint32_t> keys;
+  std::vector<int64_t> values;
+  std::vector<EventType> types;
+
+  // transaction columns, txn_event_offsets has one extra trailing element
+  std::vector<int64_t> txn_ids;
+  std::vector<uint32_t> txn_sessions;
+  std::vector<uint32_t> txn_event_offsets{0};
+
+  // session columns, session_txn_offsets has one extra trailing element
+  std::vector<int64_t> session_ids;
+  std::vector<uint32_t> session_txn_offsets{0};
+
+  // key column
+  std::vector<int64_t> key_ids;
+
+  auto num_keys() const -> size_t { return key_ids.size(); }
+  auto num_sessions() const -> size_t { return session_ids.size(); }
+  auto num_transactions() const -> size_t { return txn_ids.size(); }
+  auto num_events() const -> size_t { return keys.size(); }
+
+  auto transactions() const -> std::ranges::iota_view<uint32_t, uint32_t> {
+    return {0, static_cast<uint32_t>(num_transactions())};
+  }
+
+  auto session_transactions(uint32_t session) const
+      -> std::ranges::iota_view<uint32_t, uint32_t> {
+    return {session_txn_offsets[session], session_txn_offsets[session + 1]};
+  }
+
+  auto transaction_events(uint32_t txn) const
+      -> std::ranges::iota_view<uint32_t, uint32_t> {
+    return {txn_event_offsets[txn], txn_event_offsets[txn + 1]};
+  }
+
+  friend auto operator<<(std::ostream &os, const FlatHistory &history)
+      -> std::ostream &;
+};
+
+auto flatten(const History &history) -> FlatHistory;
+
+/**
+ * Read history from an in-memory buffer. The history is in dbcop format.
  *
  * Dbcop format:
  *
@@ -66,9 +125,35 @@ struct History {
  * ID, SESSION_NUM, KEY_NUM, TXN_NUM, EVENT_NUM, SIZE, KEY, VALUE := int64_t
  * INFO, START, END := null terminated string
  * IS_WRITE, SUCCESS := bool
+ *
+ * TXN_NUM and EVENT_NUM are the per-session and per-transaction sizes the
+ * history was generated with. Nothing checks them against the data, so they
+ * are only used as reservation estimates, capped by the remaining input.
+ * Length prefixes are validated against the remaining input, and a truncated
+ * or corrupt file throws std::runtime_error.
+ */
+auto parse_dbcop_history(std::span<const std::byte> bytes) -> History;
+
+/**
+ * Read history from an input stream. The stream is read to its end first.
  */
 auto parse_dbcop_history(std::istream &is) -> History;
 
+/**
+ * Read history from a file, decoding straight out of a memory mapping of it.
+ */
+auto parse_dbcop_history(const std::filesystem::path &path) -> History;
+
+/**
+ * Read history in dbcop format into the columnar representation directly.
+ * See parse_dbcop_history() for the format.
+ */
+auto parse_dbcop_flat_history(std::span<const std::byte> bytes)
+    -> FlatHistory;
+
+auto parse_dbcop_flat_history(const std::filesystem::path &path)
+    -> FlatHistory;
+
 }  // namespace checker::history
 
 namespace std {
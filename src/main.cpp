@@ -3,32 +3,307 @@
 #include <argparse/argparse.hpp>
 #include <boost/log/expressions.hpp>
 #include <boost/log/trivial.hpp>
+#include <algorithm>
+#include <atomic>
 #include <cctype>
 #include <chrono>
-#include <fstream>
+#include <filesystem>
+#include <glob.h>
 #include <ios>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <syncstream>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "history/constraint.h"
 #include "history/dependencygraph.h"
 #include "history/history.h"
+#include "solver/components.h"
+#include "solver/greedy.h"
 #include "solver/pruner.h"
 #include "solver/solver.h"
+#include "utils/literal.h"
 #include "utils/log.h"
+#include "utils/parallel.h"
 
 namespace history = checker::history;
 namespace solver = checker::solver;
 namespace chrono = std::chrono;
+namespace fs = std::filesystem;
+
+struct CheckOptions {
+  bool pruning = false;
+  bool elimination = true;
+  bool greedy = true;
+  size_t threads = 1;
+  solver::ReachabilityIndex reachability = solver::ReachabilityIndex::AUTO;
+  solver::CycleDetector cycle_detector = solver::CycleDetector::PEARCE_KELLY;
+  bool topological_decisions = false;
+};
+
+struct CheckResult {
+  bool accept = true;
+  chrono::milliseconds construct_time{};
+  chrono::milliseconds eliminate_time{};
+  chrono::milliseconds prune_time{};
+  chrono::milliseconds greedy_time{};
+  chrono::milliseconds solve_time{};
+};
+
+/*
+ * Z3 contexts to solve with, one per thread, created when first needed and
+ * reused across histories.
+ */
+using Contexts = std::vector<std::unique_ptr<z3::context>>;
+
+/*
+ * Solve the components on up to options.threads threads. Once a component is
+ * rejected, the components not yet started are skipped and the searches still
+ * running are interrupted.
+ */
+static auto solve_components(const std::vector<solver::Component> &components,
+                             const CheckOptions &options, Contexts &contexts)
+    -> bool {
+  auto threads = std::clamp<size_t>(options.threads, 1, components.size());
+  if (contexts.size() < threads) {
+    contexts.resize(threads);
+  }
+  // all created up front, as other workers may interrupt them
+  for (auto i = 0_uz; i < threads; i++) {
+    if (!contexts[i]) {
+      contexts[i] = std::make_unique<z3::context>();
+    }
+  }
+
+  auto rejected = std::atomic_bool{false};
+  checker::utils::parallel_for(
+      components.size(), threads, [&](size_t i, size_t worker) {
+        if (rejected) {
+          return;
+        }
+
+        const auto &component = components[i];
+        auto solver = solver::Solver{component.dependency_graph,
+                                     component.constraints, *contexts[worker],
+                                     options.cycle_detector};
+        solver.set_topological_decisions(options.topological_decisions);
+
+        // use SMT solver to solve constraints
+        if (!solver.solve() && !rejected.exchange(true)) {
+          BOOST_LOG_TRIVIAL(debug) << "component " << i << " rejected";
+          for (auto other = 0_uz; other < threads; other++) {
+            if (other != worker) {
+              contexts[other]->interrupt();
+            }
+          }
+        }
+      });
+
+  if (rejected && threads > 1) {
+    // an interrupted context is not reused, in case it is left cancelled
+    for (auto &context : contexts) {
+      context.reset();
+    }
+  }
+  return !rejected;
+}
+
+static auto check_history(const fs::path &path, const CheckOptions &options,
+                          Contexts &contexts) -> CheckResult {
+  auto result = CheckResult{};
+  auto time = chrono::steady_clock::now();
+  auto lap = [&](const char *phase) {
+    auto curr_time = chrono::steady_clock::now();
+    auto duration =
+        chrono::duration_cast<chrono::milliseconds>(curr_time - time);
+    BOOST_LOG_TRIVIAL(debug) << phase << " time: " << duration;
+    time = curr_time;
+    return duration;
+  };
+
+  // read history
+  auto history = history::parse_dbcop_flat_history(path);
+
+  // compute known graph (WR edges) and constraints from history
+  auto dependency_graph = history::known_graph_of(history);
+  auto constraints =
+      history::constraints_of(history, dependency_graph, options.threads);
+  result.construct_time = lap("construct");
+
+  CHECKER_LOG_COND(trace, logger) {
+    logger << "history: " << history << "\ndependency graph:\n"
+           << dependency_graph;
+
+    for (const auto &c : constraints) {
+      logger << history::ConstraintWithIds{c, dependency_graph};
+    }
+  }
+
+  // constraints and edges outside every cycle need neither pruning nor Z3
+  if (options.elimination) {
+    solver::eliminate_outside_cycles(dependency_graph, constraints);
+    result.eliminate_time = lap("eliminate");
+  }
+
+  if (options.pruning) {
+    result.accept =
+        solver::prune_constraints(dependency_graph, constraints,
+                                  options.threads, options.reachability);
+    result.prune_time = lap("prune");
+  }
+
+  // most histories are accepted, and a greedy guess often shows it without
+  // creating a Z3 context at all
+  if (result.accept && options.greedy) {
+    auto accepted = solver::greedy_serialization(dependency_graph, constraints);
+    result.greedy_time = lap("greedy");
+    if (accepted) {
+      BOOST_LOG_TRIVIAL(debug) << "accepted by greedy serialization";
+      return result;
+    }
+  }
+
+  if (result.accept) {
+    // transactions that share no possible edge are checked separately
+    auto components = solver::split_components(std::move(dependency_graph),
+                                               std::move(constraints));
+    result.accept = solve_components(components, options, contexts);
+    result.solve_time = lap("solve");
+  }
+
+  return result;
+}
+
+/*
+ * Expand batch mode arguments into history files: directories are searched
+ * recursively for *.bincode files, and anything that is not an existing path
+ * is taken as a glob pattern.
+ */
+static auto collect_histories(const std::vector<std::string> &patterns)
+    -> std::vector<fs::path> {
+  auto files = std::vector<fs::path>{};
+
+  auto add_path = [&](const fs::path &path) {
+    if (fs::is_directory(path)) {
+      for (const auto &entry : fs::recursive_directory_iterator{path}) {
+        if (entry.is_regular_file() && entry.path().extension() == ".bincode") {
+          files.emplace_back(entry.path());
+        }
+      }
+    } else {
+      files.emplace_back(path);
+    }
+  };
+
+  for (const auto &pattern : patterns) {
+    if (fs::exists(pattern)) {
+      add_path(pattern);
+      continue;
+    }
+
+    auto matches = glob_t{};
+    if (::glob(pattern.c_str(), 0, nullptr, &matches) != 0) {
+      ::globfree(&matches);
+      std::ostringstream os;
+      os << "No history matches '" << pattern << "'";
+      throw std::runtime_error{os.str()};
+    }
+
+    for (auto i = 0_uz; i < matches.gl_pathc; i++) {
+      add_path(matches.gl_pathv[i]);
+    }
+    ::globfree(&matches);
+  }
+
+  std::ranges::sort(files);
+  auto [first, last] = std::ranges::unique(files);
+  files.erase(first, last);
+  return files;
+}
+
+static auto json_string(std::string_view s) -> std::string {
+  auto os = std::ostringstream{};
+  os << '"';
+  for (auto c : s) {
+    switch (c) {
+      case '"':
+        os << "\\\"";
+        break;
+      case '\\':
+        os << "\\\\";
+        break;
+      case '\n':
+        os << "\\n";
+        break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          os << "\\u00" << "0123456789abcdef"[c >> 4]
+             << "0123456789abcdef"[c & 0xf];
+        } else {
+          os << c;
+        }
+    }
+  }
+  os << '"';
+  return os.str();
+}
+
+/*
+ * Check every history on a pool of workers, each with its own Z3 context;
+ * the components of a history are solved one after another on it.
+ * One JSON object per history is written to stdout as soon as it is checked:
+ *
+ *   {"file": ..., "accept": ..., "construct_ms": ..., "eliminate_ms": ...,
+ *    "prune_ms": ..., "greedy_ms": ..., "solve_ms": ...}
+ *
+ * or {"file": ..., "error": ...} if the history cannot be checked.
+ */
+static auto check_histories(const std::vector<fs::path> &files,
+                            const CheckOptions &options, size_t jobs) -> int {
+  auto contexts = std::vector<Contexts>(jobs);
+  auto n_rejected = std::atomic_size_t{0};
+  auto n_errors = std::atomic_size_t{0};
+
+  checker::utils::parallel_for(files.size(), jobs, [&](size_t i,
+                                                       size_t worker) {
+
+    auto line = std::ostringstream{};
+    line << "{\"file\": " << json_string(files.at(i).string());
+    try {
+      auto result = check_history(files.at(i), options, contexts.at(worker));
+      n_rejected += !result.accept;
+      line << ", \"accept\": " << std::boolalpha << result.accept
+           << ", \"construct_ms\": " << result.construct_time.count()
+           << ", \"eliminate_ms\": " << result.eliminate_time.count()
+           << ", \"prune_ms\": " << result.prune_time.count()
+           << ", \"greedy_ms\": " << result.greedy_time.count()
+           << ", \"solve_ms\": " << result.solve_time.count() << '}';
+    } catch (const std::exception &e) {
+      n_errors++;
+      line << ", \"error\": " << json_string(e.what()) << '}';
+    }
+
+    std::osyncstream{std::cout} << line.str() << std::endl;
+  });
+
+  BOOST_LOG_TRIVIAL(info) << "#histories: " << files.size()
+                          << ", #rejected: " << n_rejected
+                          << ", #errors: " << n_errors;
+  return n_errors != 0;
+}
 
 auto main(int argc, char **argv) -> int {
   // handle cmdline args, see checker --help
   auto args = argparse::ArgumentParser{"checker", "0.0.1"};
-  args.add_argument("history").help("History file");
+  args.add_argument("history")
+      .help("History file, or files, directories and globs with --batch")
+      .nargs(argparse::nargs_pattern::at_least_one);
   args.add_argument("--log-level")
       .help("Logging level")
       .default_value(std::string{"INFO"});
@@ -36,6 +311,35 @@ auto main(int argc, char **argv) -> int {
       .help("Do pruning")
       .default_value(false)
       .implicit_value(true);
+  args.add_argument("--no-elimination")
+      .help("Keep the constraints that can only close a cycle with both sides")
+      .default_value(false)
+      .implicit_value(true);
+  args.add_argument("--no-greedy")
+      .help("Always search with Z3, without trying a greedy serialization")
+      .default_value(false)
+      .implicit_value(true);
+  args.add_argument("--reachability")
+      .help("Reachability index for pruning: auto, matrix or session-clock")
+      .default_value(std::string{"auto"});
+  args.add_argument("--cycle-detector")
+      .help(
+          "Incremental cycle detection: pearce-kelly, order-maintenance or "
+          "two-way-search")
+      .default_value(std::string{"pearce-kelly"});
+  args.add_argument("--decisions")
+      .help(
+          "Phase of decisions on constraints: z3, or topological, following "
+          "the cycle detector's order (needs Z3 4.13 or later)")
+      .default_value(std::string{"z3"});
+  args.add_argument("--batch")
+      .help("Check many histories, printing one JSON line per history")
+      .default_value(false)
+      .implicit_value(true);
+  args.add_argument("-j", "--jobs")
+      .help("Number of worker threads")
+      .default_value(checker::utils::default_concurrency())
+      .scan<'u', size_t>();
 
   try {
     args.parse_args(argc, argv);
@@ -43,7 +347,6 @@ auto main(int argc, char **argv) -> int {
     std::cerr << e.what() << '\n';
     return 1;
   }
-
   auto log_level = args.get("--log-level");
   auto log_level_map =
       std::unordered_map<std::string, boost::log::trivial::severity_level>{
@@ -65,67 +368,63 @@ auto main(int argc, char **argv) -> int {
     throw std::invalid_argument{os.str()};
   }
 
-  auto time = chrono::steady_clock::now();
-
-  // read history
-  auto history_file = std::ifstream{args.get("history")};
-  if (!history_file.is_open()) {
+  auto reachability_map =
+      std::unordered_map<std::string, solver::ReachabilityIndex>{
+          {"auto", solver::ReachabilityIndex::AUTO},
+          {"matrix", solver::ReachabilityIndex::MATRIX},
+          {"session-clock", solver::ReachabilityIndex::SESSION_CLOCK},
+      };
+  auto reachability = args.get("--reachability");
+  if (!reachability_map.contains(reachability)) {
     std::ostringstream os;
-    os << "Cannot open file '" << args.get("history") << "'";
-    throw std::runtime_error{os.str()};
+    os << "Invalid reachability index '" << reachability << "'";
+    throw std::invalid_argument{os.str()};
   }
 
-  auto history = history::parse_dbcop_history(history_file);
-
-  // compute known graph (WR edges) and constraints from history
-  auto dependency_graph = history::known_graph_of(history);
-  auto constraints = history::constraints_of(history, dependency_graph.wr);
-
-  {
-    auto curr_time = chrono::steady_clock::now();
-    BOOST_LOG_TRIVIAL(debug)
-        << "construct time: "
-        << chrono::duration_cast<chrono::milliseconds>(curr_time - time);
-    time = curr_time;
+  auto cycle_detector_map =
+      std::unordered_map<std::string, solver::CycleDetector>{
+          {"pearce-kelly", solver::CycleDetector::PEARCE_KELLY},
+          {"order-maintenance", solver::CycleDetector::ORDER_MAINTENANCE},
+          {"two-way-search", solver::CycleDetector::TWO_WAY_SEARCH},
+      };
+  auto cycle_detector = args.get("--cycle-detector");
+  if (!cycle_detector_map.contains(cycle_detector)) {
+    std::ostringstream os;
+    os << "Invalid cycle detector '" << cycle_detector << "'";
+    throw std::invalid_argument{os.str()};
   }
 
-  CHECKER_LOG_COND(trace, logger) {
-    logger << "history: " << history << "\ndependency graph:\n"
-           << dependency_graph;
-
-    for (const auto &c : constraints) {
-      logger << c;
-    }
+  auto decisions = args.get("--decisions");
+  if (decisions != "topological" && decisions != "z3") {
+    std::ostringstream os;
+    os << "Invalid decisions '" << decisions << "'";
+    throw std::invalid_argument{os.str()};
   }
 
-  auto accept = true;
-
-  if (args["--pruning"] == true) {
-    accept = solver::prune_constraints(dependency_graph, constraints);
+  auto histories = args.get<std::vector<std::string>>("history");
+  auto options = CheckOptions{
+      .pruning = args["--pruning"] == true,
+      .elimination = args["--no-elimination"] == false,
+      .greedy = args["--no-greedy"] == false,
+      .threads = args.get<size_t>("--jobs"),
+      .reachability = reachability_map.at(reachability),
+      .cycle_detector = cycle_detector_map.at(cycle_detector),
+      .topological_decisions = decisions == "topological",
+  };
 
-    {
-      auto curr_time = chrono::steady_clock::now();
-      BOOST_LOG_TRIVIAL(debug)
-          << "prune time: "
-          << chrono::duration_cast<chrono::milliseconds>(curr_time - time);
-      time = curr_time;
-    }
+  if (args["--batch"] == true) {
+    // histories are already checked in parallel
+    auto jobs = std::exchange(options.threads, 1);
+    return check_histories(collect_histories(histories), options, jobs);
   }
 
-  if (accept) {
-    // encode constraints and known graph
-    auto solver = solver::Solver{dependency_graph, constraints};
-
-    // use SMT solver to solve constraints
-    accept = solver.solve();
-
-    {
-      auto curr_time = chrono::steady_clock::now();
-      BOOST_LOG_TRIVIAL(debug)
-          << "solve time: "
-          << chrono::duration_cast<chrono::milliseconds>(curr_time - time);
-    }
+  if (histories.size() != 1) {
+    std::cerr << "Expected exactly one history, use --batch to check more\n";
+    return 1;
   }
+
+  auto contexts = Contexts{};
+  auto accept = check_history(histories.front(), options, contexts).accept;
   std::cout << "accept: " << std::boolalpha << accept << std::endl;
 
   return 0;
@@ -0,0 +1,254 @@
+#include "components.h"
+
+#include <algorithm>
+#include <boost/log/trivial.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <numeric>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "history/constraint.h"
+#include "history/dependencygraph.h"
+#include "utils/graph.h"
+#include "utils/literal.h"
+
+using checker::history::Constraint;
+using checker::history::DependencyGraph;
+using checker::history::TypedEdge;
+using std::vector;
+
+namespace {
+
+struct DisjointSets {
+  vector<uint32_t> parent;
+  vector<uint32_t> size;
+
+  explicit DisjointSets(size_t n) : parent(n), size(n, 1) {
+    std::iota(parent.begin(), parent.end(), 0);
+  }
+
+  auto find(uint32_t v) -> uint32_t {
+    while (parent[v] != v) {
+      parent[v] = parent[parent[v]];
+      v = parent[v];
+    }
+    return v;
+  }
+
+  auto unite(uint32_t a, uint32_t b) -> void {
+    a = find(a);
+    b = find(b);
+    if (a == b) {
+      return;
+    }
+    if (size[a] < size[b]) {
+      std::swap(a, b);
+    }
+    parent[b] = a;
+    size[a] += size[b];
+  }
+};
+
+/*
+ * Call f(from, to) for the known edges and then for the edges of both sides
+ * of every constraint.
+ */
+auto for_each_possible_edge(const DependencyGraph &dependency_graph,
+                            const vector<Constraint> &constraints, auto &&f)
+    -> void {
+  for (const auto &[from, to, _] : dependency_graph.edges()) {
+    f(from, to);
+  }
+  for (const auto &c : constraints) {
+    for (const auto *edges : {&c.either_edges, &c.or_edges}) {
+      for (const auto &[from, to, _] : *edges) {
+        f(from, to);
+      }
+    }
+  }
+}
+
+constexpr auto no_component = std::numeric_limits<uint32_t>::max();
+
+}  // namespace
+
+namespace checker::solver {
+
+auto eliminate_outside_cycles(DependencyGraph &dependency_graph,
+                              vector<Constraint> &constraints) -> void {
+  auto n = dependency_graph.num_vertices();
+  auto offsets = vector<uint32_t>(n + 1);
+  for_each_possible_edge(dependency_graph, constraints,
+                         [&](auto from, auto) { offsets[from + 1]++; });
+  std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+  auto targets = vector<uint32_t>(offsets.back());
+  auto end = vector<uint32_t>(offsets.begin(), offsets.end() - 1);
+  for_each_possible_edge(
+      dependency_graph, constraints,
+      [&](auto from, auto to) { targets[end[from]++] = to; });
+
+  auto scc = utils::strongly_connected_components(n, [&](auto v) {
+    return std::span{targets}.subspan(offsets[v], offsets[v + 1] - offsets[v]);
+  });
+
+  // both sides of a constraint are always in one SCC through its WW edges,
+  // but all edges of a side go into the same transaction, so a cycle through
+  // a side needs an edge from elsewhere. An SCC whose inner edges all belong to
+  // one constraint thus only has cycles through both of its sides.
+  constexpr auto no_owner = std::numeric_limits<uint32_t>::max();
+  constexpr auto many_owners = no_owner - 1;
+  auto owner = vector<uint32_t>(n, no_owner);
+  for (const auto &[from, to, _] : dependency_graph.edges()) {
+    if (scc[from] == scc[to]) {
+      owner[scc[from]] = many_owners;
+    }
+  }
+  for (auto i = 0_uz; i < constraints.size(); i++) {
+    const auto &c = constraints[i];
+    for (const auto *edges : {&c.either_edges, &c.or_edges}) {
+      for (const auto &[from, to, _] : *edges) {
+        if (auto &o = owner[scc[from]]; scc[from] == scc[to] && o != i) {
+          o = o == no_owner ? static_cast<uint32_t>(i) : many_owners;
+        }
+      }
+    }
+  }
+
+  auto n_constraints = constraints.size();
+  auto n_kept = 0_uz;
+  for (auto i = 0_uz; i < n_constraints; i++) {
+    if (owner[scc[constraints[i].either_txn_id]] != i) {
+      if (n_kept != i) {
+        constraints[n_kept] = std::move(constraints[i]);
+      }
+      n_kept++;
+    }
+  }
+  constraints.erase(constraints.begin() + n_kept, constraints.end());
+
+  auto n_edges = dependency_graph.num_edges();
+  auto edges = vector<std::tuple<uint32_t, uint32_t, TypedEdge>>{};
+  for (const auto &[from, to, edge] : dependency_graph.edges()) {
+    if (scc[from] == scc[to]) {
+      edges.emplace_back(from, to, edge);
+    }
+  }
+  if (edges.size() != n_edges) {
+    dependency_graph.graph = DependencyGraph::Graph{n, std::move(edges)};
+  }
+
+  BOOST_LOG_TRIVIAL(debug) << "#constraints eliminated: "
+                           << n_constraints - constraints.size() << " of "
+                           << n_constraints << ", #known edges eliminated: "
+                           << n_edges - dependency_graph.num_edges() << " of "
+                           << n_edges;
+}
+
+auto split_components(DependencyGraph &&dependency_graph,
+                      vector<Constraint> &&constraints) -> vector<Component> {
+  auto n = dependency_graph.num_vertices();
+  auto sets = DisjointSets{n};
+  for_each_possible_edge(dependency_graph, constraints,
+                         [&](auto from, auto to) { sets.unite(from, to); });
+  for (const auto &c : constraints) {
+    sets.unite(c.either_txn_id, c.or_txn_id);
+  }
+
+  // number the sets with constraints, then put the rest in one more
+  auto component_of_root = vector<uint32_t>(n, no_component);
+  auto n_components = uint32_t{0};
+  for (const auto &c : constraints) {
+    auto &component = component_of_root[sets.find(c.either_txn_id)];
+    if (component == no_component) {
+      component = n_components++;
+    }
+  }
+  auto free_component = no_component;
+  auto component_of = vector<uint32_t>(n);
+  for (auto v = 0_uz; v < n; v++) {
+    auto &component = component_of_root[sets.find(v)];
+    if (component == no_component) {
+      if (free_component == no_component) {
+        free_component = n_components++;
+      }
+      component = free_component;
+    }
+    component_of[v] = component;
+  }
+
+  if (n_components <= 1) {
+    BOOST_LOG_TRIVIAL(debug) << "#components: 1";
+    auto vertices = vector<uint32_t>(n);
+    std::iota(vertices.begin(), vertices.end(), 0);
+
+    auto components = vector<Component>{};
+    components.emplace_back(Component{
+        .vertices = std::move(vertices),
+        .dependency_graph = std::move(dependency_graph),
+        .constraints = std::move(constraints),
+    });
+    return components;
+  }
+
+  auto components = vector<Component>(n_components);
+  auto local = vector<uint32_t>(n);
+  for (auto v = 0_uz; v < n; v++) {
+    auto &vertices = components[component_of[v]].vertices;
+    local[v] = static_cast<uint32_t>(vertices.size());
+    vertices.emplace_back(v);
+  }
+
+  auto edges = vector<vector<std::tuple<uint32_t, uint32_t, TypedEdge>>>(
+      n_components);
+  for (const auto &[from, to, edge] : dependency_graph.edges()) {
+    edges[component_of[from]].emplace_back(local[from], local[to], edge);
+  }
+  for (auto i = 0_uz; i < n_components; i++) {
+    auto &component = components[i];
+    auto txn_ids = vector<int64_t>{};
+    txn_ids.reserve(component.vertices.size());
+    for (auto v : component.vertices) {
+      txn_ids.emplace_back(dependency_graph.txn_id(v));
+    }
+
+    component.dependency_graph = DependencyGraph{
+        .graph = DependencyGraph::Graph{component.vertices.size(),
+                                        std::move(edges[i])},
+        .txn_ids = std::move(txn_ids),
+        .key_ids = dependency_graph.key_ids,
+    };
+  }
+
+  for (auto &c : constraints) {
+    auto &component = components[component_of[c.either_txn_id]];
+    c.either_txn_id = local[c.either_txn_id];
+    c.or_txn_id = local[c.or_txn_id];
+    for (auto *edges : {&c.either_edges, &c.or_edges}) {
+      for (auto &[from, to, _] : *edges) {
+        from = local[from];
+        to = local[to];
+      }
+    }
+    component.constraints.emplace_back(std::move(c));
+  }
+
+  // the largest searches start first, so they do not finish last
+  std::ranges::stable_sort(components, std::greater{}, [](const auto &c) {
+    return c.constraints.size();
+  });
+
+  BOOST_LOG_TRIVIAL(debug) << "#components: " << components.size()
+                           << ", largest: "
+                           << components.front().vertices.size()
+                           << " transactions, "
+                           << components.front().constraints.size()
+                           << " constraints";
+  return components;
+}
+
+}  // namespace checker::solver
@@ -0,0 +1,48 @@
+#ifndef CHECKER_SOLVER_COMPONENTS_H
+#define CHECKER_SOLVER_COMPONENTS_H
+
+#include <cstdint>
+#include <vector>
+
+#include "history/constraint.h"
+#include "history/dependencygraph.h"
+
+namespace checker::solver {
+/**
+ * A part of a dependency graph and its constraints with no edge, known or
+ * possible, to the rest. `vertices` maps its vertices back to those of the
+ * whole graph; they keep their relative order.
+ */
+struct Component {
+  std::vector<uint32_t> vertices;
+  history::DependencyGraph dependency_graph;
+  std::vector<history::Constraint> constraints;
+};
+
+/**
+ * Remove what can never be on a cycle, whichever sides are chosen, using the
+ * strongly connected components of the known edges together with both sides
+ * of every constraint: the known edges between two components, and the
+ * constraints that are the only source of edges inside their component, as
+ * a cycle there would need both of their sides.
+ */
+auto eliminate_outside_cycles(history::DependencyGraph &dependency_graph,
+                              std::vector<history::Constraint> &constraints)
+    -> void;
+
+/**
+ * Split a dependency graph into the weakly connected components of its known
+ * edges together with both sides of every constraint. A cycle stays within a
+ * component whichever sides are chosen, so each can be checked on its own.
+ *
+ * Components without constraints are merged into one, as they only need a
+ * cycle check of their known edges. Components come in decreasing number of
+ * constraints, and a graph that does not split is moved into a single
+ * component without copying.
+ */
+auto split_components(history::DependencyGraph &&dependency_graph,
+                      std::vector<history::Constraint> &&constraints)
+    -> std::vector<Component>;
+}
+
+#endif  // CHECKER_SOLVER_COMPONENTS_H
@@ -0,0 +1,185 @@
+#include "greedy.h"
+
+#include <algorithm>
+#include <boost/log/trivial.hpp>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <numeric>
+#include <ranges>
+#include <span>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "history/constraint.h"
+#include "history/dependencygraph.h"
+#include "utils/graph.h"
+#include "utils/literal.h"
+
+using checker::history::Constraint;
+using checker::history::DependencyGraph;
+using checker::utils::topological_sort;
+using std::vector;
+
+namespace {
+
+/*
+ * Successor lists of the known edges and the chosen sides' edges.
+ */
+struct Successors {
+  vector<uint32_t> offsets;
+  vector<uint32_t> targets;
+
+  static auto of(const DependencyGraph &dependency_graph,
+                 const vector<std::span<const Constraint::Edge>> &chosen)
+      -> Successors {
+    auto n = dependency_graph.num_vertices();
+    auto s = Successors{.offsets = vector<uint32_t>(n + 1), .targets = {}};
+    for (auto v = 0_uz; v < n; v++) {
+      s.offsets[v + 1] += std::ranges::distance(
+          dependency_graph.successors(static_cast<uint32_t>(v)));
+    }
+    for (const auto &edges : chosen) {
+      for (const auto &[from, to, _] : edges) {
+        s.offsets[from + 1]++;
+      }
+    }
+    std::partial_sum(s.offsets.begin(), s.offsets.end(), s.offsets.begin());
+
+    s.targets.resize(s.offsets.back());
+    auto end = vector<uint32_t>(s.offsets.begin(), s.offsets.end() - 1);
+    for (auto v = 0_uz; v < n; v++) {
+      for (auto w : dependency_graph.successors(static_cast<uint32_t>(v))) {
+        s.targets[end[v]++] = w;
+      }
+    }
+    for (const auto &edges : chosen) {
+      for (const auto &[from, to, _] : edges) {
+        s.targets[end[from]++] = to;
+      }
+    }
+    return s;
+  }
+
+  auto of_vertex(uint32_t v) const -> std::span<const uint32_t> {
+    return std::span{targets}.subspan(offsets[v], offsets[v + 1] - offsets[v]);
+  }
+};
+
+/*
+ * Kahn's algorithm, except that when every remaining vertex has an in-edge,
+ * i.e. they contain a cycle, the one earliest in `previous` is taken anyway.
+ * Returns the order and whether that ever happened.
+ */
+auto order_breaking_cycles(const Successors &successors,
+                           const vector<uint32_t> &previous)
+    -> std::pair<vector<uint32_t>, bool> {
+  auto n = previous.size();
+  auto in_degree = vector<uint32_t>(n);
+  for (auto w : successors.targets) {
+    in_degree[w]++;
+  }
+
+  auto queued = vector<bool>(n);
+  auto order = vector<uint32_t>{};
+  order.reserve(n);
+  for (auto v : previous) {
+    if (in_degree[v] == 0) {
+      queued[v] = true;
+      order.emplace_back(v);
+    }
+  }
+
+  auto broken = false;
+  auto next_previous = 0_uz;
+  for (auto i = 0_uz; i < n; i++) {
+    if (i == order.size()) {
+      while (queued[previous[next_previous]]) {
+        next_previous++;
+      }
+      queued[previous[next_previous]] = true;
+      order.emplace_back(previous[next_previous]);
+      broken = true;
+    }
+
+    for (auto w : successors.of_vertex(order[i])) {
+      if (--in_degree[w] == 0 && !queued[w]) {
+        queued[w] = true;
+        order.emplace_back(w);
+      }
+    }
+  }
+
+  return {std::move(order), broken};
+}
+
+}  // namespace
+
+namespace checker::solver {
+
+auto greedy_serialization(const DependencyGraph &dependency_graph,
+                          const vector<Constraint> &constraints) -> bool {
+  constexpr auto max_rounds = 4;
+
+  auto n = dependency_graph.num_vertices();
+  auto order = topological_sort(
+      n, [&](auto v) { return dependency_graph.successors(v); });
+  if (!order) {
+    return false;
+  }
+
+  auto position = vector<uint32_t>(n);
+  auto chosen = vector<std::span<const Constraint::Edge>>{};
+  chosen.reserve(constraints.size());
+  for (auto round = 1; round <= max_rounds; round++) {
+    for (auto i = 0_uz; i < n; i++) {
+      position[(*order)[i]] = static_cast<uint32_t>(i);
+    }
+
+    // how far the edges go back in the order, in positions
+    auto backward_distance = [&](const vector<Constraint::Edge> &edges) {
+      auto distance = 0_uz;
+      for (const auto &[from, to, _] : edges) {
+        if (position[from] > position[to]) {
+          distance += position[from] - position[to];
+        }
+      }
+      return distance;
+    };
+
+    // resolve each constraint to the side that agrees more with the order
+    chosen.clear();
+    auto total_distance = 0_uz;
+    for (const auto &c : constraints) {
+      auto either_distance = backward_distance(c.either_edges);
+      auto or_distance = backward_distance(c.or_edges);
+      chosen.emplace_back(either_distance <= or_distance ? c.either_edges
+                                                         : c.or_edges);
+      total_distance += std::min(either_distance, or_distance);
+    }
+
+    BOOST_LOG_TRIVIAL(debug)
+        << "greedy serialization round " << round
+        << ": chosen edges go back " << total_distance << " positions";
+    if (total_distance == 0) {
+      return true;
+    }
+
+    // otherwise the chosen edges may still be acyclic; if not, sort them
+    // anyway for the next round
+    auto [next_order, has_cycle] = order_breaking_cycles(
+        Successors::of(dependency_graph, chosen), *order);
+    if (!has_cycle) {
+      return true;
+    }
+    if (next_order == *order) {
+      break;
+    }
+    *order = std::move(next_order);
+  }
+
+  return false;
+}
+
+}  // namespace checker::solver
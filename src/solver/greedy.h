@@ -0,0 +1,25 @@
+#ifndef CHECKER_SOLVER_GREEDY_H
+#define CHECKER_SOLVER_GREEDY_H
+
+#include <vector>
+
+#include "history/constraint.h"
+#include "history/dependencygraph.h"
+
+namespace checker::solver {
+/**
+ * Try to resolve every constraint at once, in linear time per round: take a
+ * topological order of the dependency graph, resolve each constraint to the
+ * side whose edges go back the least in it, and check the result for a
+ * cycle. If there is one, the next of a few rounds starts from an order of
+ * the result with its cycles broken.
+ *
+ * Returns true if that graph is acyclic, which proves the history
+ * acceptable. False proves nothing; the constraints are left to the solver.
+ */
+auto greedy_serialization(const history::DependencyGraph &dependency_graph,
+                          const std::vector<history::Constraint> &constraints)
+    -> bool;
+}
+
+#endif  // CHECKER_SOLVER_GREEDY_H
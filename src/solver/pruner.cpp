@@ -1,165 +1,228 @@
 #include "pruner.h"
 
-#include <boost/dynamic_bitset.hpp>
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/adjacency_matrix.hpp>
-#include <boost/graph/topological_sort.hpp>
+#include <algorithm>
 #include <boost/log/trivial.hpp>
+#include <cstddef>
 #include <cstdint>
-#include <functional>
-#include <iterator>
+#include <numeric>
 #include <optional>
-#include <ranges>
-#include <unordered_set>
+#include <span>
+#include <tuple>
+#include <utility>
 #include <vector>
 
 #include "history/constraint.h"
 #include "history/dependencygraph.h"
+#include "reachability.h"
+#include "utils/literal.h"
 #include "utils/log.h"
-#include "utils/ranges.h"
-#include "utils/to_container.h"
-
-using boost::add_edge;
-using boost::adjacency_list;
-using boost::adjacency_matrix;
-using boost::dynamic_bitset;
-using boost::no_named_parameters;
-using boost::not_a_dag;
-using boost::out_edges;
-using boost::target;
-using boost::topological_sort;
+#include "utils/parallel.h"
+
 using checker::history::Constraint;
+using checker::history::ConstraintWithIds;
 using checker::history::DependencyGraph;
-using checker::history::EdgeType;
-using checker::utils::as_range;
-using checker::utils::to;
-using std::back_inserter;
-using std::nullopt;
+using checker::solver::MatrixReachability;
+using checker::solver::ReachabilityIndex;
+using checker::solver::SessionChains;
+using checker::solver::SessionClockReachability;
 using std::optional;
-using std::unordered_set;
 using std::vector;
-using std::ranges::copy;
-using std::ranges::views::filter;
-
-namespace checker::solver {
-auto prune_constraints(DependencyGraph &dependency_graph,
-                       vector<Constraint> &constraints) -> bool {
-  auto &&vertex_map = dependency_graph.rw.vertex_map.left;
-  auto pruned_constraints = unordered_set<Constraint *>{};
-  auto not_pruned =
-      filter([&](auto &&c) { return !pruned_constraints.contains(&c); });
-  bool changed = true;
-
-  CHECKER_LOG_COND(trace, logger) {
-    logger << "vertex_map:";
-    for (auto &&[v, desc] : vertex_map) {
-      logger << " (" << v << ", " << desc << ')';
-    }
-  }
 
-  while (changed) {
-    changed = false;
+namespace {
+
+/*
+ * For each vertex, the constraints with an edge into it. A side with an edge
+ * from->to closes a cycle iff `to` reaches `from`, so a constraint can only
+ * become forced after the reachable set of one of those vertices grows.
+ */
+struct ConstraintIndex {
+  vector<uint32_t> offsets;
+  vector<uint32_t> constraints;
+
+  static auto of(size_t num_vertices, const vector<Constraint> &constraints)
+      -> ConstraintIndex {
+    auto index = ConstraintIndex{.offsets = vector<uint32_t>(num_vertices + 1)};
+    auto for_each_target = [&](const Constraint &c, auto &&f) {
+      for (const auto *edges : {&c.either_edges, &c.or_edges}) {
+        for (const auto &e : *edges) {
+          f(std::get<1>(e));
+        }
+      }
+    };
 
-    auto known_graph = adjacency_list<>{dependency_graph.num_vertices()};
-    for (auto &&[from, to, _] : dependency_graph.edges()) {
-      add_edge(vertex_map.at(from), vertex_map.at(to), known_graph);
+    for (const auto &c : constraints) {
+      for_each_target(c, [&](auto to) { index.offsets[to + 1]++; });
+    }
+    std::partial_sum(index.offsets.begin(), index.offsets.end(),
+                     index.offsets.begin());
+
+    index.constraints.resize(index.offsets.back());
+    auto end = vector<uint32_t>(index.offsets.begin(), index.offsets.end() - 1);
+    for (auto i = 0_uz; i < constraints.size(); i++) {
+      for_each_target(constraints[i], [&](auto to) {
+        index.constraints[end[to]++] = static_cast<uint32_t>(i);
+      });
     }
 
-    auto reverse_topo_order =
-        [&]() -> optional<vector<adjacency_list<>::vertex_descriptor>> {
-      auto v = vector<adjacency_list<>::vertex_descriptor>(
-          dependency_graph.num_vertices());
-
-      try {
-        topological_sort(known_graph, v.begin(), no_named_parameters());
-      } catch (not_a_dag &e) {
-        return nullopt;
-      }
+    return index;
+  }
 
-      return {std::move(v)};
-    }();
+  auto of_vertex(uint32_t v) const -> std::span<const uint32_t> {
+    return std::span{constraints}.subspan(offsets[v],
+                                          offsets[v + 1] - offsets[v]);
+  }
+};
+
+template <typename Reachability>
+auto prune_with(DependencyGraph &dependency_graph,
+                vector<Constraint> &constraints, Reachability &reachability,
+                size_t threads) -> bool {
+  enum class Forced : uint8_t { NONE, EITHER, OR, PRUNED };
+  auto forced = vector<Forced>(constraints.size(), Forced::NONE);
+  auto n_pruned = 0_uz;
+  auto n_rounds = 0_uz;
+  auto n_visited = 0_uz;
+
+  auto index =
+      ConstraintIndex::of(dependency_graph.num_vertices(), constraints);
+
+  // every constraint is checked once, then only those the index points to
+  auto worklist = vector<uint32_t>(constraints.size());
+  std::iota(worklist.begin(), worklist.end(), 0);
+  auto queued = vector<bool>(constraints.size(), true);
+  auto next_worklist = vector<uint32_t>{};
+  auto grown = vector<uint32_t>{};
+
+  while (!worklist.empty()) {
+    n_rounds++;
+    n_visited += worklist.size();
+
+    // find forced constraints; this only reads the closure, so it runs in
+    // parallel
+    checker::utils::parallel_for(
+        worklist.size(), threads,
+        [&](size_t j, size_t) {
+          auto i = worklist[j];
+          const auto &c = constraints[i];
+          auto creates_cycle = [&](const vector<Constraint::Edge> &edges) {
+            return std::ranges::any_of(edges, [&](const auto &e) {
+              const auto &[from, to, _] = e;
+              return reachability.reaches(to, from);
+            });
+          };
+
+          if (creates_cycle(c.either_edges)) {
+            forced[i] = Forced::OR;
+          } else if (creates_cycle(c.or_edges)) {
+            forced[i] = Forced::EITHER;
+          }
+        },
+        1024);
 
-    if (!reverse_topo_order) {
-      BOOST_LOG_TRIVIAL(debug) << "conflict found in pruning";
-      return false;
+    for (auto i : worklist) {
+      queued[i] = false;
     }
 
-    auto reachability = [&]() {
-      auto r = vector<dynamic_bitset<>>{
-          dependency_graph.num_vertices(),
-          dynamic_bitset<>{dependency_graph.num_vertices()}};
-
-      for (auto &&v : reverse_topo_order.value()) {
-        r.at(v).set(v);
+    // add the forced edges; the closure only grows, so a side found to
+    // create a cycle above still does
+    for (auto i : worklist) {
+      if (forced[i] != Forced::EITHER && forced[i] != Forced::OR) {
+        continue;
+      }
 
-        for (auto &&e : as_range(out_edges(v, known_graph))) {
-          auto v2 = target(e, known_graph);
-          if (!r.at(v)[v2]) {
-            r.at(v) |= r.at(v2);
+      const auto &c = constraints[i];
+      const auto &added_edges =
+          forced[i] == Forced::EITHER ? c.either_edges : c.or_edges;
+      for (const auto &[from, to, info] : added_edges) {
+        grown.clear();
+        if (!reachability.add_edge(from, to, grown)) {
+          BOOST_LOG_TRIVIAL(debug) << "conflict found in pruning";
+          return false;
+        }
+        dependency_graph.add_edge(from, to, info);
+
+        for (auto v : grown) {
+          for (auto k : index.of_vertex(v)) {
+            if (!queued[k] && forced[k] == Forced::NONE) {
+              queued[k] = true;
+              next_worklist.emplace_back(k);
+            }
           }
         }
       }
 
-      return r;
-    }();
+      BOOST_LOG_TRIVIAL(trace)
+          << "pruned constraint, added "
+          << (forced[i] == Forced::EITHER ? "either" : "or")
+          << " edges: " << ConstraintWithIds{c, dependency_graph};
+      forced[i] = Forced::PRUNED;
+      n_pruned++;
+    }
 
-    for (auto &&c : constraints | not_pruned) {
-      auto check_edges = [&](const vector<Constraint::Edge> &edges) {
-        for (auto &&[from, to, _] : edges) {
-          if (reachability.at(vertex_map.at(to))[vertex_map.at(from)]) {
-            return false;
-          }
-        }
+    // fold this round's edges into the CSR rows to keep edge() lookups cheap
+    dependency_graph.graph.compact();
 
-        return true;
-      };
-      auto add_edges = [&](const vector<Constraint::Edge> &edges) {
-        for (auto &&[from, to, info] : edges) {
-          switch (info.type) {
-            case EdgeType::WW:
-              if (auto e = dependency_graph.ww.edge(from, to); e) {
-                copy(info.keys, back_inserter(e.value().get().keys));
-              } else {
-                dependency_graph.ww.add_edge(from, to, info);
-              }
-              break;
-            case EdgeType::RW:
-              if (auto e = dependency_graph.rw.edge(from, to); e) {
-                copy(info.keys, back_inserter(e.value().get().keys));
-              } else {
-                dependency_graph.rw.add_edge(from, to, info);
-              }
-              break;
-            default:
-              assert(false);
-          }
-        }
-      };
-
-      auto added_edges_name = "or";
-      if (!check_edges(c.either_edges)) {
-        add_edges(c.or_edges);
-        changed = true;
-      } else if (!check_edges(c.or_edges)) {
-        add_edges(c.either_edges);
-        changed = true;
-        added_edges_name = "either";
-      }
+    std::swap(worklist, next_worklist);
+    next_worklist.clear();
+  }
+
+  BOOST_LOG_TRIVIAL(debug) << "#pruned constraints: " << n_pruned
+                           << ", #pruning rounds: " << n_rounds
+                           << ", #constraints visited: " << n_visited;
 
-      if (changed) {
-        pruned_constraints.emplace(&c);
-        BOOST_LOG_TRIVIAL(trace) << "pruned constraint, added "
-                                 << added_edges_name << " edges: " << c;
+  auto n_kept = 0_uz;
+  for (auto i = 0_uz; i < constraints.size(); i++) {
+    if (forced[i] != Forced::PRUNED) {
+      if (n_kept != i) {
+        constraints[n_kept] = std::move(constraints[i]);
       }
+      n_kept++;
     }
   }
+  constraints.erase(constraints.begin() + n_kept, constraints.end());
 
-  BOOST_LOG_TRIVIAL(debug) << "#pruned constraints: "
-                           << pruned_constraints.size();
+  return true;
+}
 
-  constraints = constraints | not_pruned | to<vector<Constraint>>;
+}  // namespace
 
-  return true;
+namespace checker::solver {
+auto prune_constraints(DependencyGraph &dependency_graph,
+                       vector<Constraint> &constraints, size_t threads,
+                       ReachabilityIndex index) -> bool {
+  auto chains = optional<SessionChains>{};
+  if (index == ReachabilityIndex::AUTO) {
+    // vector clocks take 64 * #chains bits per vertex, the matrices 2 * V
+    chains = SessionChains::of(dependency_graph);
+    index = chains->num_chains() * 32 <= dependency_graph.num_vertices()
+                ? ReachabilityIndex::SESSION_CLOCK
+                : ReachabilityIndex::MATRIX;
+  }
+
+  if (index == ReachabilityIndex::SESSION_CLOCK) {
+    if (!chains) {
+      chains = SessionChains::of(dependency_graph);
+    }
+    BOOST_LOG_TRIVIAL(debug) << "reachability index: session clocks over "
+                             << chains->num_chains() << " chains";
+
+    auto reachability = SessionClockReachability::of(dependency_graph,
+                                                     std::move(*chains));
+    if (!reachability) {
+      BOOST_LOG_TRIVIAL(debug) << "conflict found in pruning";
+      return false;
+    }
+    return prune_with(dependency_graph, constraints, *reachability, threads);
+  } else {
+    BOOST_LOG_TRIVIAL(debug) << "reachability index: bit matrix";
+
+    auto reachability = MatrixReachability::of(dependency_graph, threads);
+    if (!reachability) {
+      BOOST_LOG_TRIVIAL(debug) << "conflict found in pruning";
+      return false;
+    }
+    return prune_with(dependency_graph, constraints, *reachability, threads);
+  }
 }
 
 }  // namespace checker::solver
@@ -1,14 +1,27 @@
 #ifndef CHECKER_SOLVER_PRUNER_H
 #define CHECKER_SOLVER_PRUNER_H
 
+#include <cstddef>
 #include <vector>
 
 #include "history/constraint.h"
 #include "history/dependencygraph.h"
+#include "reachability.h"
 
 namespace checker::solver {
+/**
+ * Resolve the constraints one of whose sides would close a cycle in the
+ * dependency graph, adding the other side's edges to the graph. Returns false
+ * if a cycle is unavoidable.
+ *
+ * With ReachabilityIndex::AUTO, session clocks are used when the history has
+ * few sessions compared to its transactions, and bit matrices otherwise.
+ */
 auto prune_constraints(history::DependencyGraph &dependency_graph,
-                       std::vector<history::Constraint> &constraints) -> bool;
+                       std::vector<history::Constraint> &constraints,
+                       size_t threads = 1,
+                       ReachabilityIndex index = ReachabilityIndex::AUTO)
+    -> bool;
 }
 
 #endif  // CHECKER_SOLVER_PRUNER_H
@@ -0,0 +1,228 @@
+#include "reachability.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <ranges>
+#include <tuple>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "history/dependencygraph.h"
+#include "utils/bitmatrix.h"
+#include "utils/graph.h"
+#include "utils/literal.h"
+
+using checker::history::DependencyGraph;
+using checker::utils::topological_sort;
+using checker::utils::transitive_closure;
+using std::nullopt;
+using std::optional;
+using std::tuple;
+using std::vector;
+
+namespace checker::solver {
+
+auto MatrixReachability::of(const DependencyGraph &graph, size_t threads)
+    -> optional<MatrixReachability> {
+  auto n = graph.num_vertices();
+
+  auto reach = transitive_closure(
+      n, [&](auto v) { return graph.successors(v); }, threads);
+  if (!reach) {
+    return nullopt;
+  }
+
+  auto reversed_edges = vector<tuple<uint32_t, uint32_t, std::monostate>>{};
+  reversed_edges.reserve(graph.num_edges());
+  for (const auto &[from, to, _] : graph.edges()) {
+    reversed_edges.emplace_back(to, from, std::monostate{});
+  }
+  auto predecessors =
+      utils::Graph<uint32_t, std::monostate>{n, std::move(reversed_edges)};
+
+  auto reached_by = transitive_closure(
+      n, [&](auto v) { return predecessors.successors(v); }, threads);
+
+  return MatrixReachability{
+      .reach = std::move(*reach),
+      .reached_by = std::move(*reached_by),
+  };
+}
+
+auto MatrixReachability::add_edge(uint32_t from, uint32_t to,
+                                  vector<uint32_t> &grown) -> bool {
+  if (reaches(to, from)) {
+    return false;
+  }
+  if (reaches(from, to)) {
+    return true;
+  }
+
+  // everything that reaches `from` now reaches everything `to` reaches; row
+  // `to` of reach and row `from` of reached_by are not modified below, as that
+  // would need a path to->from
+  reached_by.for_each_set(from, [&](size_t x) {
+    if (!reach.test(x, to)) {
+      reach.or_row(x, to);
+      grown.emplace_back(x);
+    }
+  });
+  reach.for_each_set(to, [&](size_t y) {
+    if (!reached_by.test(y, from)) {
+      reached_by.or_row(y, from);
+    }
+  });
+
+  return true;
+}
+
+auto SessionChains::of(const DependencyGraph &graph) -> SessionChains {
+  auto n = graph.num_vertices();
+  auto next = vector<uint32_t>(n, SessionClockReachability::no_position);
+  auto has_prev = vector<bool>(n);
+  for (const auto &[from, to, _] : graph.so()) {
+    assert(next[from] == SessionClockReachability::no_position);
+    next[from] = to;
+    has_prev[to] = true;
+  }
+
+  auto chains = SessionChains{
+      .chain_of = vector<uint32_t>(n),
+      .position = vector<uint32_t>(n),
+  };
+  chains.vertices.reserve(n);
+
+  for (auto head = 0_uz; head < n; head++) {
+    if (has_prev[head]) {
+      continue;
+    }
+
+    auto chain = static_cast<uint32_t>(chains.num_chains());
+    auto pos = uint32_t{0};
+    for (auto v = static_cast<uint32_t>(head);
+         v != SessionClockReachability::no_position; v = next[v]) {
+      chains.chain_of[v] = chain;
+      chains.position[v] = pos++;
+      chains.vertices.emplace_back(v);
+    }
+    chains.offsets.emplace_back(chains.vertices.size());
+  }
+
+  assert(chains.vertices.size() == n);
+  return chains;
+}
+
+auto SessionClockReachability::of(const DependencyGraph &graph,
+                                  SessionChains chains)
+    -> optional<SessionClockReachability> {
+  auto n = graph.num_vertices();
+  auto s = chains.num_chains();
+
+  auto order =
+      topological_sort(n, [&](auto v) { return graph.successors(v); });
+  if (!order) {
+    return nullopt;
+  }
+
+  auto r = SessionClockReachability{
+      .chains = std::move(chains),
+      .first = vector<uint32_t>(n * s, no_position),
+      .reached_by_end = vector<uint32_t>(n * s, 0),
+  };
+  const auto &c = r.chains;
+
+  // successors first, then take the elementwise minimum
+  for (auto v : *order | std::ranges::views::reverse) {
+    auto *row = &r.first[v * s];
+    row[c.chain_of[v]] = c.position[v];
+    for (auto w : graph.successors(v)) {
+      const auto *w_row = &r.first[w * s];
+      for (auto k = 0_uz; k < s; k++) {
+        row[k] = std::min(row[k], w_row[k]);
+      }
+    }
+  }
+
+  // predecessors first, pushing the elementwise maximum forward
+  for (auto v : *order) {
+    auto *row = &r.reached_by_end[v * s];
+    row[c.chain_of[v]] = c.position[v] + 1;
+    for (auto w : graph.successors(v)) {
+      auto *w_row = &r.reached_by_end[w * s];
+      for (auto k = 0_uz; k < s; k++) {
+        w_row[k] = std::max(w_row[k], row[k]);
+      }
+    }
+  }
+
+  return r;
+}
+
+auto SessionClockReachability::add_edge(uint32_t from, uint32_t to,
+                                        vector<uint32_t> &grown) -> bool {
+  if (reaches(to, from)) {
+    return false;
+  }
+  if (reaches(from, to)) {
+    return true;
+  }
+
+  auto s = chains.num_chains();
+
+  // everything that reaches `from` can now reach what `to` reaches. Within a
+  // chain, earlier vertices already reach at least what later ones do, so the
+  // walk down a chain stops at the first vertex that does not change. The
+  // first row of `to` and the reached_by_end row of `from` are only read,
+  // since modifying them would need a path to->from.
+  const auto *to_first = &first[to * s];
+  for (auto chain = 0_uz; chain < s; chain++) {
+    for (auto pos = reached_by_end[from * s + chain]; pos-- > 0;) {
+      auto v = chains.at(chain, pos);
+      auto *row = &first[v * s];
+      auto changed = false;
+      for (auto k = 0_uz; k < s; k++) {
+        if (to_first[k] < row[k]) {
+          if (record_undo) {
+            undo_log.emplace_back(&row[k], row[k]);
+          }
+          row[k] = to_first[k];
+          changed = true;
+        }
+      }
+      if (!changed) {
+        break;
+      }
+      grown.emplace_back(v);
+    }
+  }
+
+  // and symmetrically, everything `to` reaches is reached by what reaches
+  // `from`
+  const auto *from_end = &reached_by_end[from * s];
+  for (auto chain = 0_uz; chain < s; chain++) {
+    for (auto pos = first[to * s + chain]; pos < chains.length(chain); pos++) {
+      auto *row = &reached_by_end[chains.at(chain, pos) * s];
+      auto changed = false;
+      for (auto k = 0_uz; k < s; k++) {
+        if (from_end[k] > row[k]) {
+          if (record_undo) {
+            undo_log.emplace_back(&row[k], row[k]);
+          }
+          row[k] = from_end[k];
+          changed = true;
+        }
+      }
+      if (!changed) {
+        break;
+      }
+    }
+  }
+
+  return true;
+}
+
+}  // namespace checker::solver
@@ -0,0 +1,138 @@
+#ifndef CHECKER_SOLVER_REACHABILITY_H
+#define CHECKER_SOLVER_REACHABILITY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+#include "history/dependencygraph.h"
+#include "utils/bitmatrix.h"
+
+namespace checker::solver {
+
+/**
+ * Reachability indices over a dependency graph that only ever gains edges.
+ * Both provide:
+ *
+ *   reaches(from, to): whether there is a path from->to (or from == to)
+ *   add_edge(from, to): add an edge, returning false and leaving the index
+ *     unchanged if it would close a cycle
+ *   add_edge(from, to, grown): the same, also appending to `grown` every
+ *     vertex whose set of reachable vertices grew
+ *
+ * reaches() only reads the index, so it may be called from many threads at
+ * once.
+ */
+enum class ReachabilityIndex { AUTO, MATRIX, SESSION_CLOCK };
+
+/**
+ * The transitive closure as bit matrices: row v of reach is the set of
+ * vertices reachable from v and row v of reached_by the set of vertices that
+ * reach v. Takes O(V^2) bits.
+ */
+struct MatrixReachability {
+  utils::BitMatrix reach;
+  utils::BitMatrix reached_by;
+
+  /*
+   * Returns nullopt if the graph has a cycle.
+   */
+  static auto of(const history::DependencyGraph &graph, size_t threads)
+      -> std::optional<MatrixReachability>;
+
+  auto reaches(uint32_t from, uint32_t to) const -> bool {
+    return reach.test(from, to);
+  }
+
+  auto add_edge(uint32_t from, uint32_t to) -> bool {
+    auto grown = std::vector<uint32_t>{};
+    return add_edge(from, to, grown);
+  }
+
+  auto add_edge(uint32_t from, uint32_t to, std::vector<uint32_t> &grown)
+      -> bool;
+};
+
+/**
+ * The session chains of a dependency graph, i.e. its maximal paths of SO
+ * edges. A transaction without SO edges is a chain of its own.
+ */
+struct SessionChains {
+  std::vector<uint32_t> chain_of;
+  std::vector<uint32_t> position;
+  std::vector<uint32_t> offsets{0};  // chain c is vertices[offsets[c]..]
+  std::vector<uint32_t> vertices;
+
+  static auto of(const history::DependencyGraph &graph) -> SessionChains;
+
+  auto num_chains() const -> size_t { return offsets.size() - 1; }
+
+  auto length(size_t chain) const -> uint32_t {
+    return offsets[chain + 1] - offsets[chain];
+  }
+
+  auto at(size_t chain, uint32_t pos) const -> uint32_t {
+    return vertices[offsets[chain] + pos];
+  }
+};
+
+/**
+ * Reachability as vector clocks over the session chains. A transaction
+ * reaches everything after it in its session, so it is enough to keep, for
+ * each vertex v and chain c:
+ *
+ *   first[v][c]: the earliest position in c reachable from v
+ *   reached_by_end[v][c]: one past the latest position in c that reaches v
+ *
+ * reaches() is a single lookup, and the index takes O(V * S) words for S
+ * sessions, which is much less than a bit matrix when S is small.
+ *
+ * With record_undo set, add_edge() logs every entry it overwrites, so that a
+ * backtracking search can undo(n) back to when the log had n entries.
+ */
+struct SessionClockReachability {
+  static constexpr auto no_position = std::numeric_limits<uint32_t>::max();
+
+  struct Overwritten {
+    uint32_t *entry;
+    uint32_t value;
+  };
+
+  SessionChains chains;
+  std::vector<uint32_t> first;
+  std::vector<uint32_t> reached_by_end;
+  bool record_undo = false;
+  std::vector<Overwritten> undo_log;
+
+  /*
+   * Returns nullopt if the graph has a cycle.
+   */
+  static auto of(const history::DependencyGraph &graph, SessionChains chains)
+      -> std::optional<SessionClockReachability>;
+
+  auto reaches(uint32_t from, uint32_t to) const -> bool {
+    return first[from * chains.num_chains() + chains.chain_of[to]] <=
+           chains.position[to];
+  }
+
+  auto add_edge(uint32_t from, uint32_t to) -> bool {
+    auto grown = std::vector<uint32_t>{};
+    return add_edge(from, to, grown);
+  }
+
+  auto add_edge(uint32_t from, uint32_t to, std::vector<uint32_t> &grown)
+      -> bool;
+
+  auto undo(size_t n) -> void {
+    while (undo_log.size() > n) {
+      *undo_log.back().entry = undo_log.back().value;
+      undo_log.pop_back();
+    }
+  }
+};
+
+}  // namespace checker::solver
+
+#endif  // CHECKER_SOLVER_REACHABILITY_H
@@ -3,58 +3,57 @@
 #include <z3++.h>
 
 #include <algorithm>
-#include <boost/container_hash/extensions.hpp>
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/depth_first_search.hpp>
-#include <boost/graph/filtered_graph.hpp>
-#include <boost/graph/reverse_graph.hpp>
-#include <boost/graph/visitors.hpp>
 #include <boost/log/trivial.hpp>
-#include <boost/property_map/vector_property_map.hpp>
 #include <cassert>
 #include <cstddef>
 #include <cstdint>
 #include <cstdio>
+#include <deque>
 #include <functional>
 #include <iostream>
 #include <iterator>
+#include <limits>
 #include <memory>
 #include <numeric>
 #include <optional>
 #include <queue>
 #include <ranges>
-#include <sstream>
+#include <span>
 #include <stdexcept>
 #include <string>
 #include <string_view>
 #include <tuple>
+#include <type_traits>
 #include <unordered_map>
 #include <unordered_set>
 #include <utility>
+#include <variant>
 #include <vector>
 
 #include "history/constraint.h"
 #include "history/dependencygraph.h"
+#include "reachability.h"
 #include "utils/log.h"
 #include "utils/ranges.h"
 #include "utils/to_container.h"
 #include "utils/toposort.h"
+#include "utils/trail_graph.h"
+
+#if __has_include(<z3_version.h>)
+#include <z3_version.h>
+#endif
+
+// Z3 calls user propagators back on decisions, which next_split() may
+// change, from 4.13 on
+#if defined(Z3_MAJOR_VERSION) && \
+    (Z3_MAJOR_VERSION > 4 || (Z3_MAJOR_VERSION == 4 && Z3_MINOR_VERSION >= 13))
+#define CHECKER_Z3_HAS_DECIDE 1
+#else
+#define CHECKER_Z3_HAS_DECIDE 0
+#endif
 
-using boost::add_edge;
-using boost::add_vertex;
-using boost::adjacency_list;
-using boost::bidirectionalS;
-using boost::directedS;
-using boost::edge;
-using boost::hash_setS;
-using boost::no_property;
-using boost::num_vertices;
-using boost::remove_edge;
-using boost::source;
-using boost::target;
-using boost::vecS;
-using boost::vertex_index_t;
 using checker::history::Constraint;
+using checker::history::ConstraintWithIds;
 using checker::utils::to;
 using std::back_inserter;
 using std::get;
@@ -73,121 +72,154 @@ using std::ranges::views::all;
 using std::ranges::views::drop;
 using std::ranges::views::filter;
 using std::ranges::views::iota;
-using std::ranges::views::keys;
 using std::ranges::views::reverse;
 using std::ranges::views::single;
-using std::ranges::views::transform;
 using z3::expr;
 using z3::expr_vector;
 
-template <>
-struct std::hash<expr> {
-  auto operator()(const expr &e) const -> size_t { return e.hash(); }
-};
+namespace checker::solver {
 
-template <>
-struct std::hash<pair<adjacency_list<>::vertex_descriptor,
-                      adjacency_list<>::vertex_descriptor>> {
-  auto operator()(const pair<adjacency_list<>::vertex_descriptor,
-                             adjacency_list<>::vertex_descriptor> &p) const
-      -> size_t {
-    auto h = boost::hash<adjacency_list<>::vertex_descriptor>{};
-    return h(p.first) ^ h(p.second);
+/*
+ * The polygraph as the propagator sees it: each distinct edge once in a
+ * sorted table, so that an edge is identified by its index, and the edges
+ * each SMT variable enables in CSR form. Variable 0 is true, a dummy
+ * enabling the known edges, and variables 2i+1 and 2i+2 are the either and
+ * or sides of constraint i.
+ */
+struct PolyGraph {
+  using VertexPair = pair<uint32_t, uint32_t>;
+
+  size_t num_vertices = 0;
+  vector<int64_t> txn_ids;  // of the history, for logging
+  vector<VertexPair> edges;
+  vector<uint32_t> var_edge_offsets{0};
+  vector<uint32_t> var_edges;
+
+  auto num_vars() const -> size_t { return var_edge_offsets.size() - 1; }
+
+  auto txn_id(uint32_t v) const -> int64_t {
+    return v < txn_ids.size() ? txn_ids[v] : v;
+  }
+
+  auto edges_of(size_t var) const -> std::span<const uint32_t> {
+    return std::span{var_edges}.subspan(
+        var_edge_offsets[var],
+        var_edge_offsets[var + 1] - var_edge_offsets[var]);
   }
-};
 
-template <>
-struct std::equal_to<expr> {
-  auto operator()(const expr &left, const expr &right) const -> bool {
-    return left.id() == right.id();
+  // the edge from->to, which must be in the table
+  auto edge_id(uint32_t from, uint32_t to) const -> uint32_t {
+    auto it = std::ranges::lower_bound(edges, VertexPair{from, to});
+    assert(it != edges.end() && *it == VertexPair(from, to));
+    return static_cast<uint32_t>(it - edges.begin());
+  }
+
+  static auto of(const history::DependencyGraph &known_graph,
+                 const vector<history::Constraint> &constraints) -> PolyGraph {
+    auto polygraph = PolyGraph{
+        .num_vertices = known_graph.num_vertices(),
+        .txn_ids = known_graph.txn_ids,
+    };
+    auto &edges = polygraph.edges;
+
+    // deduplicate the edges by sorting them
+    auto num_constraint_edges = 0_uz;
+    for (const auto &c : constraints) {
+      num_constraint_edges += c.either_edges.size() + c.or_edges.size();
+    }
+    edges.reserve(known_graph.num_edges() + num_constraint_edges);
+    for (const auto &[from, to, _] : known_graph.edges()) {
+      edges.emplace_back(from, to);
+    }
+    for (const auto &c : constraints) {
+      for (const auto *side : {&c.either_edges, &c.or_edges}) {
+        for (const auto &[from, to, _] : *side) {
+          edges.emplace_back(from, to);
+        }
+      }
+    }
+    std::ranges::sort(edges);
+    edges.erase(std::ranges::unique(edges).begin(), edges.end());
+
+    polygraph.var_edge_offsets.reserve(2 * constraints.size() + 2);
+    polygraph.var_edges.reserve(known_graph.num_edges() + num_constraint_edges);
+    for (const auto &[from, to, _] : known_graph.edges()) {
+      polygraph.var_edges.emplace_back(polygraph.edge_id(from, to));
+    }
+    polygraph.var_edge_offsets.emplace_back(polygraph.var_edges.size());
+    for (const auto &c : constraints) {
+      for (const auto *side : {&c.either_edges, &c.or_edges}) {
+        for (const auto &[from, to, _] : *side) {
+          polygraph.var_edges.emplace_back(polygraph.edge_id(from, to));
+        }
+        polygraph.var_edge_offsets.emplace_back(polygraph.var_edges.size());
+      }
+    }
+
+    return polygraph;
   }
 };
 
-namespace checker::solver {
+Solver::Solver(const history::DependencyGraph &known_graph,
+               const vector<history::Constraint> &constraints,
+               CycleDetector cycle_detector)
+    : Solver{known_graph, constraints, std::make_unique<z3::context>(),
+             nullptr, cycle_detector} {}
 
 Solver::Solver(const history::DependencyGraph &known_graph,
-               const vector<history::Constraint> &constraints)
-    : solver{context, z3::solver::simple{}} {
-  using Graph = adjacency_list<hash_setS, vecS, directedS, int64_t>;
-  using Vertex = Graph::vertex_descriptor;
-  using Edge = Graph::edge_descriptor;
-  using EdgeSet = unordered_set<Edge, boost::hash<Edge>>;
+               const vector<history::Constraint> &constraints,
+               z3::context &context, CycleDetector cycle_detector)
+    : Solver{known_graph, constraints, nullptr, &context, cycle_detector} {}
 
+Solver::Solver(const history::DependencyGraph &known_graph,
+               const vector<history::Constraint> &constraints,
+               std::unique_ptr<z3::context> owned_context,
+               z3::context *shared_context, CycleDetector cycle_detector)
+    : owned_context{std::move(owned_context)},
+      context{shared_context ? *shared_context : *this->owned_context},
+      solver{context, z3::solver::simple{}} {
   CHECKER_LOG_COND(trace, logger) {
-    logger << "wr:\n" << known_graph.wr << "cons:\n";
+    logger << "known graph:\n" << known_graph << "cons:\n";
     for (const auto &c : constraints) {
-      logger << c;
+      logger << ConstraintWithIds{c, known_graph};
     }
   }
 
-  auto polygraph = Graph{};
-  auto vertex_map = unordered_map<int64_t, Vertex>{};
-  auto edge_map = unordered_map<pair<Vertex, Vertex>, Edge>{};
-
-  auto get_vertex = [&](int64_t id) {
-    if (vertex_map.contains(id)) {
-      return vertex_map.at(id);
-    }
-    return vertex_map.try_emplace(id, add_vertex(id, polygraph)).first->second;
-  };
-  auto get_edge = [&](int64_t from, int64_t to) {
-    auto from_desc = get_vertex(from);
-    auto to_desc = get_vertex(to);
-
-    if (auto it = edge_map.find({from_desc, to_desc}); it != edge_map.end()) {
-      return it->second;
-    } else {
-      return edge_map
-          .try_emplace({from_desc, to_desc},
-                       add_edge(from_desc, to_desc, polygraph).first)
-          .first->second;
-    }
-  };
-  auto add_constraint_edge = transform([&](const Constraint::Edge &e) {
-    const auto &[from, to, _] = e;
-    return get_edge(from, to);
-  });
-
-  auto constraint_edges = unordered_map<expr, vector<Edge>>{};
-
-  // use true as a dummy constraint variable for known edges
-  auto z3_true = context.bool_val(true);
-  auto known_edges = EdgeSet{};
-  for (const auto &[from, to, _] : known_graph.edges()) {
-    BOOST_LOG_TRIVIAL(trace) << "known: " << from << "->" << to;
-    known_edges.emplace(get_edge(from, to));
-  }
-  constraint_edges.try_emplace(z3_true, known_edges | to<vector<Edge>>);
-
-  for (const auto &c : constraints) {
-    std::stringstream either_name, or_name;
-    either_name << c.either_txn_id << "->" << c.or_txn_id;
-    or_name << c.or_txn_id << "->" << c.either_txn_id;
+  auto polygraph = PolyGraph::of(known_graph, constraints);
 
-    auto either_var = context.bool_const(either_name.str().c_str());
-    auto or_var = context.bool_const(or_name.str().c_str());
-    solver.add(either_var ^ or_var);
-
-    constraint_edges.try_emplace(
-        either_var, c.either_edges | add_constraint_edge | to<vector<Edge>>);
-    constraint_edges.try_emplace(
-        or_var, c.or_edges | add_constraint_edge | to<vector<Edge>>);
+  // variables are named by their index rather than by a formatted string;
+  // the names of the sides they stand for are only logged
+  auto vars = vector<expr>{};
+  vars.reserve(polygraph.num_vars());
+  vars.emplace_back(context.bool_val(true));
+  for (auto i = 1_uz; i < polygraph.num_vars(); i++) {
+    vars.emplace_back(context.constant(
+        context.int_symbol(static_cast<int>(i)), context.bool_sort()));
+  }
+  for (auto i = 0_uz; i < constraints.size(); i++) {
+    solver.add(vars[2 * i + 1] ^ vars[2 * i + 2]);
   }
 
   CHECKER_LOG_COND(trace, logger) {
-    logger << "vertex_map:";
-    for (auto [a, b] : vertex_map) {
-      logger << ' ' << a << ":" << b;
+    logger << "vars:";
+    for (auto i = 0_uz; i < constraints.size(); i++) {
+      const auto &c = constraints[i];
+      auto either_id = known_graph.txn_id(c.either_txn_id);
+      auto or_id = known_graph.txn_id(c.or_txn_id);
+      logger << ' ' << vars[2 * i + 1] << '=' << either_id << "->" << or_id
+             << ' ' << vars[2 * i + 2] << '=' << or_id << "->" << either_id;
     }
   }
 
   CHECKER_LOG_COND(trace, logger) {
     logger << "constraint_edges:";
-    for (auto &&[c, v] : constraint_edges) {
-      logger << c.to_string() << '[';
-      for (auto i = 0_uz; i < v.size(); i++) {
-        logger << v[i];
-        if (i != v.size() - 1) {
+    for (auto i = 0_uz; i < vars.size(); i++) {
+      logger << vars[i].to_string() << '[';
+      auto edges = polygraph.edges_of(i);
+      for (auto j = 0_uz; j < edges.size(); j++) {
+        const auto &[from, to] = polygraph.edges[edges[j]];
+        logger << polygraph.txn_id(from) << "->" << polygraph.txn_id(to);
+        if (j != edges.size() - 1) {
           logger << ' ';
         }
       }
@@ -195,8 +227,20 @@ Solver::Solver(const history::DependencyGraph &known_graph,
     }
   }
 
+  // reachability for theory propagation, with an undo log as the search
+  // backtracks
+  auto reachability = SessionClockReachability::of(
+      known_graph, SessionChains::of(known_graph));
+  if (reachability) {
+    reachability->record_undo = true;
+  } else {
+    BOOST_LOG_TRIVIAL(debug) << "known graph has a cycle";
+    solver.add(context.bool_val(false));
+  }
+
   user_propagator = std::make_unique<DependencyGraphHasNoCycle>(
-      solver, std::move(polygraph), std::move(constraint_edges));
+      solver, std::move(polygraph), std::move(vars), std::move(reachability),
+      cycle_detector);
 }
 
 auto Solver::solve() -> bool { return solver.check() == z3::sat; }
@@ -204,30 +248,48 @@ auto Solver::solve() -> bool { return solver.check() == z3::sat; }
 Solver::~Solver() = default;
 
 struct DependencyGraphHasNoCycle : z3::user_propagator_base {
-  using PolyGraph = adjacency_list<hash_setS, vecS, directedS, int64_t>;
-  using PolyGraphVertex = PolyGraph::vertex_descriptor;
-  using PolyGraphEdge = PolyGraph::edge_descriptor;
-  using PolyGraphEdgeSet =
-      unordered_set<PolyGraphEdge, boost::hash<PolyGraphEdge>>;
-
-  using Graph =
-      adjacency_list<vecS, vecS, directedS, no_property, optional<expr>>;
+  // edges are added and removed in the order Z3 fixes and unfixes variables,
+  // so undoing a scope truncates the graph's edge stack
+  using Graph = utils::TrailGraph<uint32_t, uint32_t>;
   using Vertex = Graph::vertex_descriptor;
   using Edge = Graph::edge_descriptor;
-
-  static_assert(std::is_same_v<PolyGraphVertex, Vertex> &&
-                std::is_integral_v<Vertex>);
+  static constexpr auto no_var = std::numeric_limits<uint32_t>::max();
 
   PolyGraph polygraph;
 
+  /*
+   * The registered SMT variables, numbered as in the polygraph. Everything
+   * below refers to variables by index; their expressions are only used to
+   * talk to Z3.
+   */
+  vector<expr> vars;
+  vector<uint32_t> var_of_ast;  // Z3 AST id -> variable index, or no_var
+
   /*
    * A dependency graph contains the current set of fixed edges of the
    * polygraph. Each edge has a set of variables that enables it. These
-   * variables are currently assigned true by Z3.
+   * variables are currently assigned true by Z3. Its edges are the stack of
+   * fixed edges: edge i is the i-th polygraph edge fixed, and its payload is
+   * its index in the polygraph. The bottom of the stack is the known graph;
+   * it is added once, before the first push(), so pop() never removes it.
+   *
+   * Edges are reference counted, so that an edge implied by several fixed
+   * variables is present once: num_enablers counts the fixed variables
+   * implying each polygraph edge, and enabler is the one that added it,
+   * which stays fixed for as long as the edge is present. Known edges are
+   * enabled by variable 0.
    */
   Graph dependency_graph;
-  utils::IncrementalCycleDetector<Graph> cycle_detector;
+  vector<uint32_t> num_enablers;
+  vector<uint32_t> enabler;
+  std::variant<
+      std::monostate,
+      utils::IncrementalCycleDetector<Graph, utils::PearceKelly<Graph>>,
+      utils::IncrementalCycleDetector<Graph, utils::OrderMaintenance<Graph>>,
+      utils::IncrementalCycleDetector<Graph, utils::TwoWaySearch<Graph>>>
+      cycle_detector;
   bool has_conflict = false;
+  bool topological_decisions = false;
 
   /*
    * Z3 uses a stack of fixed variables internally. When push() is called, a new
@@ -240,113 +302,215 @@ struct DependencyGraphHasNoCycle : z3::user_propagator_base {
    */
   vector<size_t> fixed_vars_num;   // total number of fixed variables at this
                                    // scope and lower scope
-  vector<expr> fixed_vars;         // fixed variables at each scope
+  vector<uint32_t> fixed_vars;     // fixed variables at each scope
   vector<size_t> fixed_edges_num;  // total number of fixed edges
-  vector<Edge> fixed_edges;        // stack of fixed edges
+  vector<EdgeEvent> *edge_events = nullptr;
 
-  // SMT variable -> polygraph edges to add
-  unordered_map<expr, vector<PolyGraphEdge>> constraint_to_edge_map;
+  // SMT variable -> variables to propagate, used for WW propagation; the
+  // conjunction of variable i's is propagate_conseqs[i]
+  vector<uint32_t> propagate_offsets{0};
+  vector<uint32_t> propagate_vars;
+  vector<expr> propagate_conseqs;
 
-  // SMT variable -> propagate expr, used for WW propagation
-  unordered_map<expr, expr> propagate_map;
+  // polygraph edge -> SMT variables enabling it; the variables of edge i are
+  // edge_vars[edge_var_offsets[i]..edge_var_offsets[i + 1])
+  vector<uint32_t> edge_var_offsets;
+  vector<uint32_t> edge_vars;
 
-  // edge -> conflicting SMT variables, used for incremental pruning
-  unordered_map<PolyGraphEdge, vector<expr>, boost::hash<PolyGraphEdge>>
-      conflict_map;
+  /*
+   * Theory propagation. Reachability over the known graph and the fixed
+   * edges is kept incrementally and undone on pop(). Once a reaches b, the
+   * variables of every edge b->a would close a cycle, so they are propagated
+   * to false, justified by the fixed variables on a path a->b. Absent if the
+   * known graph has a cycle.
+   */
+  optional<SessionClockReachability> reachability;
+  vector<size_t> undo_log_num;        // reachability undo log size per scope
+  vector<uint32_t> in_edge_offsets;  // polygraph edges by target, in in_edges
+  vector<uint32_t> in_edges;
+  vector<bool> is_false;          // fixed or propagated to false
+  vector<uint32_t> false_vars;    // stack of variables set in is_false
+  vector<size_t> false_vars_num;  // total number of false variables
+  vector<uint32_t> grown;         // scratch space
+
+  /*
+   * Conflict explanation: a 0-1 BFS over the known graph and the fixed edges
+   * for the cycle with the fewest fixed variables, bounded by the cycle the
+   * detector found. cycle_cost, cycle_parent and cycle_parent_var are indexed
+   * by vertex; cycle_cost is `unreached` except during a search, which resets
+   * the vertices in cycle_reached. in_clause is indexed by variable, and is
+   * cleared after each use.
+   */
+  static constexpr auto unreached = std::numeric_limits<uint32_t>::max();
+  vector<Edge> detected_cycle;
+  vector<uint32_t> cycle_cost;
+  vector<Vertex> cycle_parent;
+  vector<uint32_t> cycle_parent_var;
+  vector<Vertex> cycle_reached;
+  std::deque<Vertex> cycle_frontier;
+  vector<bool> in_clause;
 
   // statistics
   size_t n_fixed_called = 0;
+  size_t n_fixed_edges = 0;
+  size_t n_shared_edges = 0;
   size_t n_conflicts_returned = 0;
   size_t n_conflict_vars_returned = 0;
   size_t n_pop_called = 0;
   size_t n_pop_scopes = 0;
   size_t n_propagate_called = 0;
   size_t n_propagate_vars = 0;
+  size_t n_theory_propagations = 0;
+  size_t n_justification_vars = 0;
+  size_t n_decisions = 0;
+  size_t n_steered_decisions = 0;
 
   DependencyGraphHasNoCycle(
-      z3::solver &solver, PolyGraph &&polygraph,
-      unordered_map<expr, vector<Edge>> &&constraint_edges)
+      z3::solver &solver, PolyGraph &&polygraph, vector<expr> &&vars,
+      optional<SessionClockReachability> &&reachability,
+      CycleDetector algorithm)
       : z3::user_propagator_base{&solver},
         polygraph{std::move(polygraph)},
-        dependency_graph{num_vertices(this->polygraph)},
-        cycle_detector{dependency_graph},
-        constraint_to_edge_map{std::move(constraint_edges)},
-        propagate_map{[&]() {
-          auto ww_edge_to_var =
-              constraint_to_edge_map                                 //
-              | filter([](auto &&p) { return !p.first.is_true(); })  //
-              | transform([](auto &&p) {
-                  return pair{p.second.front(), p.first};
-                })  //
-              | to<unordered_map<PolyGraphEdge, expr,
-                                 boost::hash<PolyGraphEdge>>>;
-
-          CHECKER_LOG_COND(trace, logger) {
-            logger << "ww_edge_to_var:";
-            for (auto &&[e, p] : ww_edge_to_var) {
-              logger << ' ' << boost::source(e, this->polygraph) << "->"
-                     << boost::target(e, this->polygraph) << "=>"
-                     << p.to_string();
-            }
-          }
+        vars{std::move(vars)},
+        dependency_graph{this->polygraph.num_vertices,
+                         this->polygraph.edges},
+        num_enablers(this->polygraph.edges.size()),
+        enabler(this->polygraph.edges.size()),
+        edge_var_offsets(this->polygraph.edges.size() + 1),
+        reachability{std::move(reachability)},
+        in_edge_offsets(this->polygraph.num_vertices + 1),
+        is_false(this->vars.size()),
+        cycle_cost(this->polygraph.num_vertices, unreached),
+        cycle_parent(this->polygraph.num_vertices),
+        cycle_parent_var(this->polygraph.num_vertices),
+        in_clause(this->vars.size()) {
+    const auto &g = this->polygraph;
+    assert(this->vars.size() == g.num_vars());
+    for (auto i = 0_uz; i < this->vars.size(); i++) {
+      auto id = this->vars[i].id();
+      if (id >= var_of_ast.size()) {
+        var_of_ast.resize(id + 1, no_var);
+      }
+      var_of_ast[id] = static_cast<uint32_t>(i);
+    }
 
-          return constraint_to_edge_map  //
-                 | transform([&](auto &&p) {
-                     auto vars =
-                         p.second  //
-                         | filter([&](auto &&e) {
-                             return ww_edge_to_var.contains(e) &&
-                                    ww_edge_to_var.at(e).id() != p.first.id();
-                           })  //
-                         | transform([&](auto &&e) {
-                             return ww_edge_to_var.at(e);
-                           })  //
-                         | to<expr_vector>(ctx());
-                     return pair{
-                         p.first,
-                         z3::mk_and(vars),
-                     };
-                   })  //
-                 |
-                 filter([&](auto &&p) { return p.second.num_args() != 0; })  //
-                 | to<unordered_map<expr, expr>>;
-        }()},
-        conflict_map{[&]() {
-          auto m = unordered_map<PolyGraphEdge, vector<expr>,
-                                 boost::hash<PolyGraphEdge>>{};
-
-          for (auto &&[ex, edges] : this->constraint_to_edge_map) {
-            for (auto &&e : edges) {
-              m[e].emplace_back(ex);
-            }
-          }
+    // the first edge of a constraint variable is its WW edge
+    auto ww_edge_to_var = vector<uint32_t>(g.edges.size(), no_var);
+    for (auto i = 1_uz; i < g.num_vars(); i++) {
+      if (auto edges = g.edges_of(i);
+          !edges.empty() && ww_edge_to_var[edges.front()] == no_var) {
+        ww_edge_to_var[edges.front()] = static_cast<uint32_t>(i);
+      }
+    }
+
+    CHECKER_LOG_COND(trace, logger) {
+      logger << "ww_edge_to_var:";
+      for (auto e = 0_uz; e < g.edges.size(); e++) {
+        if (ww_edge_to_var[e] != no_var) {
+          logger << ' ' << g.txn_id(g.edges[e].first) << "->"
+                 << g.txn_id(g.edges[e].second) << "=>"
+                 << this->vars[ww_edge_to_var[e]].to_string();
+        }
+      }
+    }
+
+    propagate_conseqs.reserve(g.num_vars());
+    for (auto i = 0_uz; i < g.num_vars(); i++) {
+      auto conseq = expr_vector{ctx()};
+      for (auto e : g.edges_of(i)) {
+        if (auto v = ww_edge_to_var[e]; v != no_var && v != i) {
+          propagate_vars.emplace_back(v);
+          conseq.push_back(this->vars[v]);
+        }
+      }
+      propagate_offsets.emplace_back(propagate_vars.size());
+      propagate_conseqs.emplace_back(z3::mk_and(conseq));
+    }
+
+    // invert var_edges by counting sort
+    for (auto e : g.var_edges) {
+      edge_var_offsets[e + 1]++;
+    }
+    std::partial_sum(edge_var_offsets.begin(), edge_var_offsets.end(),
+                     edge_var_offsets.begin());
+    edge_vars.resize(edge_var_offsets.back());
+    auto edge_vars_end = vector<uint32_t>(edge_var_offsets.begin(),
+                                          edge_var_offsets.end() - 1);
+    for (auto i = 0_uz; i < g.num_vars(); i++) {
+      for (auto e : g.edges_of(i)) {
+        edge_vars[edge_vars_end[e]++] = static_cast<uint32_t>(i);
+      }
+    }
 
-          return m;
-        }()} {
-    for (const auto &var : keys(constraint_to_edge_map)) {
+    for (const auto &[from, to] : g.edges) {
+      in_edge_offsets[to + 1]++;
+    }
+    std::partial_sum(in_edge_offsets.begin(), in_edge_offsets.end(),
+                     in_edge_offsets.begin());
+    in_edges.resize(g.edges.size());
+    auto in_edges_end = vector<uint32_t>(in_edge_offsets.begin(),
+                                         in_edge_offsets.end() - 1);
+    for (auto e = 0_uz; e < g.edges.size(); e++) {
+      in_edges[in_edges_end[g.edges[e].second]++] = static_cast<uint32_t>(e);
+    }
+
+    // the known graph is the base layer of the dependency graph, unless it
+    // has a cycle and the solver is unsatisfiable anyway
+    if (this->reachability) {
+      for (auto e : g.edges_of(0)) {
+        auto [from, to] = g.edges[e];
+        dependency_graph.add_edge(from, to, e);
+        num_enablers[e] = 1;
+      }
+    }
+
+    // var 0 is `true`, whose edges are the known graph added above; watching
+    // it would add them again when Z3 fixes it, so the sides whose WW edge is
+    // known are asserted here instead of propagated
+    for (const auto &var : this->vars | drop(1)) {
       BOOST_LOG_TRIVIAL(trace) << "add: " << var.to_string();
       add(var);
     }
+    if (propagate_offsets[0] != propagate_offsets[1]) {
+      solver.add(propagate_conseqs[0]);
+    }
 
     CHECKER_LOG_COND(trace, logger) {
       logger << "propagate_map:\n";
-      for (auto &&[v, p] : propagate_map) {
-        logger << v.to_string() << "=>";
-        for (auto &&v2 : p) {
-          logger << ' ' << v2.to_string();
+      for (auto i = 0_uz; i < this->vars.size(); i++) {
+        if (propagate_offsets[i] != propagate_offsets[i + 1]) {
+          logger << this->vars[i].to_string() << "=> "
+                 << propagate_conseqs[i].to_string() << '\n';
         }
-        logger << '\n';
       }
     }
 
+    switch (algorithm) {
+      case CycleDetector::PEARCE_KELLY:
+        cycle_detector.emplace<1>(dependency_graph);
+        break;
+      case CycleDetector::ORDER_MAINTENANCE:
+        cycle_detector.emplace<2>(dependency_graph);
+        break;
+      case CycleDetector::TWO_WAY_SEARCH:
+        cycle_detector.emplace<3>(dependency_graph);
+        break;
+    }
+
     register_fixed();
+#if CHECKER_Z3_HAS_DECIDE
+    register_decide();
+#endif
   }
 
   auto push() -> void override {
     BOOST_LOG_TRIVIAL(trace) << "push";
     assert(!has_conflict);
     fixed_vars_num.emplace_back(fixed_vars.size());
-    fixed_edges_num.emplace_back(fixed_edges.size());
+    fixed_edges_num.emplace_back(num_edges(dependency_graph));
+    false_vars_num.emplace_back(false_vars.size());
+    undo_log_num.emplace_back(reachability ? reachability->undo_log.size()
+                                           : 0);
   }
 
   auto pop(unsigned int num_scopes) -> void override {
@@ -362,71 +526,217 @@ struct DependencyGraphHasNoCycle : z3::user_propagator_base {
 
     CHECKER_LOG_COND(trace, logger) {
       logger << "unfix:";
-      for (auto &&var : fixed_vars | drop(remaining_vars_num)) {
-        logger << ' ' << var.to_string();
+      for (auto var : fixed_vars | drop(remaining_vars_num)) {
+        logger << ' ' << vars[var].to_string();
+      }
+    }
+
+    if (edge_events) {
+      for (auto e = num_edges(dependency_graph); e-- > remaining_edges_num;) {
+        edge_events->emplace_back(
+            EdgeEvent::REMOVE,
+            source(static_cast<Edge>(e), dependency_graph),
+            target(static_cast<Edge>(e), dependency_graph));
+      }
+    }
+    dependency_graph.truncate(remaining_edges_num);
+    for (auto var : fixed_vars | drop(remaining_vars_num)) {
+      for (auto e : polygraph.edges_of(var)) {
+        num_enablers[e]--;
       }
     }
 
-    for (auto &&e : fixed_edges | drop(remaining_edges_num)) {
-      boost::remove_edge(e, dependency_graph);
+    for (auto var : false_vars | drop(false_vars_num.at(remaining_scopes))) {
+      is_false[var] = false;
     }
+    false_vars.resize(false_vars_num.at(remaining_scopes));
+    false_vars_num.resize(remaining_scopes);
+    if (reachability) {
+      reachability->undo(undo_log_num.at(remaining_scopes));
+    }
+    undo_log_num.resize(remaining_scopes);
 
     has_conflict = false;
-    fixed_vars.erase(fixed_vars.begin() + remaining_vars_num, fixed_vars.end());
-    fixed_edges.erase(fixed_edges.begin() + remaining_edges_num,
-                      fixed_edges.end());
+    fixed_vars.resize(remaining_vars_num);
   }
 
-  auto fixed(const expr &var, const expr &value) -> void override {
-    if (has_conflict || value.is_false()) {
+  auto fixed(const expr &var_expr, const expr &value) -> void override {
+    if (has_conflict) {
       return;
     }
 
-    BOOST_LOG_TRIVIAL(trace) << "fixed: " << var.to_string();
+    auto var = var_of_ast[var_expr.id()];
+    assert(var != no_var);
+    if (value.is_false()) {
+      set_false(var);
+      return;
+    }
+
+    BOOST_LOG_TRIVIAL(trace) << "fixed: " << var_expr.to_string();
     n_fixed_called++;
     fixed_vars.push_back(var);
 
-    for (const auto &pe : constraint_to_edge_map.at(var)) {
-      auto e = add_edge(source(pe, polygraph), target(pe, polygraph), var,
-                        dependency_graph)
-                   .first;
-      fixed_edges.emplace_back(e);
+    // add the edges of the variable not present yet, then check them in one
+    // pass; an edge already present changes nothing
+    auto first_edge = static_cast<Edge>(num_edges(dependency_graph));
+    for (auto e : polygraph.edges_of(var)) {
+      n_fixed_edges++;
+      if (num_enablers[e]++ > 0) {
+        n_shared_edges++;
+        continue;
+      }
+
+      auto [from, to] = polygraph.edges[e];
+      enabler[e] = var;
+      dependency_graph.add_edge(from, to, e);
+      if (edge_events) {
+        edge_events->emplace_back(EdgeEvent::ADD, from, to);
+      }
+    }
 
-      if (!detect_cycle(e)) {
+    auto last_edge = static_cast<Edge>(num_edges(dependency_graph));
+    if (first_edge != last_edge) {
+      if (edge_events) {
+        edge_events->emplace_back(EdgeEvent::CHECK);
+      }
+      if (!detect_cycle(iota(first_edge, last_edge)) ||
+          !propagate_acyclicity(var, first_edge)) {
+        explain_conflict(var, first_edge);
         has_conflict = true;
         return;
       }
+    }
+    propagate_var(var);
+  }
 
-      // propagate_edge(var, e);
+  auto set_false(uint32_t var) -> void {
+    if (!is_false[var]) {
+      is_false[var] = true;
+      false_vars.emplace_back(var);
     }
+  }
 
-    propagate_var(var);
+#if CHECKER_Z3_HAS_DECIDE
+  /*
+   * Z3 is about to decide a variable. For a constraint side, decide instead
+   * for the side with fewer edges against the cycle detector's order, so
+   * that the search tends to extend the order rather than close a cycle.
+   */
+  auto decide(const expr &val, unsigned bit, bool is_pos) -> void override {
+    auto id = val.id();
+    auto var = id < var_of_ast.size() ? var_of_ast[id] : no_var;
+    if (!topological_decisions || var == no_var || var == 0) {
+      return;
+    }
+
+    n_decisions++;
+    if (auto side = preferred_side(var); side != no_var) {
+      if (auto pos = side == var; pos != is_pos) {
+        n_steered_decisions++;
+        next_split(val, bit, pos ? Z3_L_TRUE : Z3_L_FALSE);
+      }
+    }
+  }
+#endif
+
+  /*
+   * The side of var's constraint whose absent edges go against the cycle
+   * detector's order fewer times, or no_var on a tie.
+   */
+  auto preferred_side(uint32_t var) const -> uint32_t {
+    auto either = var - (var - 1) % 2;
+    auto backward_edges = [&](uint32_t side) {
+      auto n = 0_uz;
+      for (auto e : polygraph.edges_of(side)) {
+        auto [from, to] = polygraph.edges[e];
+        n += num_enablers[e] == 0 && !before(from, to);
+      }
+      return n;
+    };
+
+    auto n_either = backward_edges(either);
+    auto n_or = backward_edges(either + 1);
+    if (n_either == n_or) {
+      return no_var;
+    }
+    return n_either < n_or ? either : either + 1;
+  }
+
+  auto before(Vertex a, Vertex b) const -> bool {
+    return std::visit(
+        [&](const auto &detector) {
+          if constexpr (std::is_same_v<std::decay_t<decltype(detector)>,
+                                       std::monostate>) {
+            return true;
+          } else {
+            return detector.before(a, b);
+          }
+        },
+        cycle_detector);
   }
 
   auto fresh(z3::context &ctx) -> z3::user_propagator_base * override {
     return this;
   }
 
-  // incremental cycle detection
-  auto detect_cycle(Edge added_edge) -> bool {
-    auto cycle = cycle_detector.check_add_edge(added_edge);
+  // incremental cycle detection; a cycle found is kept in detected_cycle
+  auto detect_cycle(std::ranges::forward_range auto &&added_edges) -> bool {
+    auto cycle = std::visit(
+        [&](auto &detector) -> optional<vector<Edge>> {
+          if constexpr (std::is_same_v<std::decay_t<decltype(detector)>,
+                                       std::monostate>) {
+            assert(false);
+            return std::nullopt;
+          } else {
+            return detector.check_add_edges(added_edges);
+          }
+        },
+        cycle_detector);
     if (!cycle) {
+      detected_cycle.clear();
       return true;
     }
+    detected_cycle = std::move(*cycle);
 
     CHECKER_LOG_COND(trace, logger) {
-      logger << "conflict:";
-      for (auto e : cycle.value()) {
-        logger << ' ' << polygraph[source(e, dependency_graph)] << "->"
-               << polygraph[target(e, dependency_graph)];
+      logger << "cycle:";
+      for (auto e : detected_cycle) {
+        logger << ' ' << polygraph.txn_id(source(e, dependency_graph)) << "->"
+               << polygraph.txn_id(target(e, dependency_graph));
       }
     }
+    return false;
+  }
 
-    auto cycle_exprs = z3::expr_vector{ctx()};
-    for (auto e : cycle.value()) {
-      cycle_exprs.push_back(dependency_graph[e].value());
+  /*
+   * Report a conflict for `var`, whose edges from first_edge on close a
+   * cycle. Any cycle does, so pick the one with the fewest other fixed
+   * variables: for each new edge u->w, the cheapest path w->u where known
+   * edges and the edges of `var` are free. The searches only look for paths
+   * cheaper than the best cycle so far, starting from the detector's.
+   */
+  auto explain_conflict(uint32_t var, Edge first_edge) -> void {
+    auto best = vector<uint32_t>{};
+    auto found = !detected_cycle.empty();
+    for (auto e : detected_cycle) {
+      if (auto pe = dependency_graph[e]; !is_free(pe, var)) {
+        best.emplace_back(enabler[pe]);
+      }
+    }
+
+    for (auto e = first_edge; e < num_edges(dependency_graph); e++) {
+      auto bound = found ? static_cast<uint32_t>(best.size()) : unreached;
+      auto path = cheapest_path(target(e, dependency_graph),
+                                source(e, dependency_graph), var, bound);
+      if (path) {
+        best = std::move(*path);
+        found = true;
+      }
     }
+    assert(found);
+    best.emplace_back(var);
 
+    auto cycle_exprs = clause_of(best);
     CHECKER_LOG_COND(trace, logger) {
       logger << "conflict expr:";
       for (const auto &e : cycle_exprs) {
@@ -437,65 +747,205 @@ struct DependencyGraphHasNoCycle : z3::user_propagator_base {
     n_conflicts_returned++;
     n_conflict_vars_returned += cycle_exprs.size();
     conflict(cycle_exprs);
-    return false;
+  }
+
+  // whether polygraph edge e costs nothing in a conflict for free_var
+  auto is_free(uint32_t e, uint32_t free_var) const -> bool {
+    auto var = enabler[e];
+    return var == 0 || var == free_var || is_enabled_by(e, free_var);
+  }
+
+  /*
+   * The variables on a path a->b with the fewest variables other than
+   * `free_var` or 0, found by a 0-1 BFS; nullopt if b is unreachable with
+   * fewer than `bound` of them, and the search stops at that cost. Edges
+   * `free_var` implies are free too, whichever variable added them. A
+   * variable enabling several edges of the path is counted, and returned,
+   * once per edge.
+   */
+  auto cheapest_path(Vertex a, Vertex b, uint32_t free_var, uint32_t bound)
+      -> optional<vector<uint32_t>> {
+    cycle_frontier.clear();
+    cycle_cost[a] = 0;
+    cycle_reached.emplace_back(a);
+    cycle_frontier.emplace_back(a);
+
+    auto relax = [&](Vertex x, Vertex y, uint32_t e) {
+      auto free = is_free(e, free_var);
+      auto cost = cycle_cost[x] + (free ? 0 : 1);
+      if (cost < cycle_cost[y] && cost < bound) {
+        if (cycle_cost[y] == unreached) {
+          cycle_reached.emplace_back(y);
+        }
+        cycle_cost[y] = cost;
+        cycle_parent[y] = x;
+        cycle_parent_var[y] = free ? no_var : enabler[e];
+        if (free) {
+          cycle_frontier.emplace_front(y);
+        } else {
+          cycle_frontier.emplace_back(y);
+        }
+      }
+    };
+
+    while (!cycle_frontier.empty()) {
+      auto x = cycle_frontier.front();
+      cycle_frontier.pop_front();
+      if (x == b) {
+        break;
+      }
+
+      for (auto e : utils::as_range(out_edges(x, dependency_graph))) {
+        relax(x, target(e, dependency_graph), dependency_graph[e]);
+      }
+    }
+
+    auto path = optional<vector<uint32_t>>{};
+    if (cycle_cost[b] != unreached) {
+      path.emplace();
+      for (auto y = b; y != a; y = cycle_parent[y]) {
+        if (cycle_parent_var[y] != no_var) {
+          path->emplace_back(cycle_parent_var[y]);
+        }
+      }
+    }
+
+    for (auto v : cycle_reached) {
+      cycle_cost[v] = unreached;
+    }
+    cycle_reached.clear();
+    return path;
+  }
+
+  auto is_enabled_by(uint32_t e, uint32_t var) const -> bool {
+    auto vars_of_e = std::span{edge_vars}.subspan(
+        edge_var_offsets[e], edge_var_offsets[e + 1] - edge_var_offsets[e]);
+    return std::ranges::find(vars_of_e, var) != vars_of_e.end();
+  }
+
+  // the literals of `path_vars`, each once, without the true variable 0
+  auto clause_of(const vector<uint32_t> &path_vars) -> expr_vector {
+    auto clause = expr_vector{ctx()};
+    for (auto v : path_vars) {
+      if (v != 0 && !in_clause[v]) {
+        in_clause[v] = true;
+        clause.push_back(vars[v]);
+      }
+    }
+    for (auto v : path_vars) {
+      in_clause[v] = false;
+    }
+    return clause;
   }
 
   // assignment propagation using WW edges
-  auto propagate_var(const expr &var) -> void {
-    auto it = propagate_map.find(var);
-    if (it == propagate_map.end()) {
+  auto propagate_var(uint32_t var) -> void {
+    auto n_vars = propagate_offsets[var + 1] - propagate_offsets[var];
+    if (n_vars == 0) {
       return;
     }
 
     n_propagate_called++;
-    n_propagate_vars += it->second.num_args();
+    n_propagate_vars += n_vars;
     CHECKER_LOG_COND(trace, logger) {
-      logger << "propagate: " << var.to_string() << "=>";
-      for (auto &&v : it->second.args()) {
-        logger << ' ' << v.to_string();
-      }
+      logger << "propagate: " << vars[var].to_string() << "=> "
+             << propagate_conseqs[var].to_string();
     }
 
-    propagate(single(var) | to<expr_vector>(ctx()), it->second);
+    auto fixed = expr_vector{ctx()};
+    fixed.push_back(vars[var]);
+    propagate(fixed, propagate_conseqs[var]);
   }
 
-  auto propagate_edge(const expr &var, Edge e) -> void {
-    auto from = source(e, dependency_graph);
-    auto to = target(e, dependency_graph);
-
-    auto conseq = ctx().bool_val(true);
-    auto successors = std::unordered_set<Vertex>{};
-    auto edges = std::unordered_set<PolyGraphEdge, boost::hash<PolyGraphEdge>>{};
+  /*
+   * Propagate the variables whose edges would close a cycle with the edges
+   * of `var`, from first_edge on, to false. Returns false if those edges
+   * close a cycle, which the cycle detector, seeing the known graph too, has
+   * ruled out already; the conflict itself is left to explain_conflict().
+   */
+  auto propagate_acyclicity(uint32_t var, Edge first_edge) -> bool {
+    if (!reachability) {
+      return true;
+    }
 
-    std::function<void(Vertex)> get_successors = [&](Vertex current){
-      for (auto e : utils::as_range(boost::out_edges(current, dependency_graph))) {
-        auto to = target(e, dependency_graph);
-        edges.emplace(edge(current, to, polygraph).first);
+    grown.clear();
+    for (auto e = first_edge; e < num_edges(dependency_graph); e++) {
+      auto from = source(e, dependency_graph);
+      auto to = target(e, dependency_graph);
+      if (!reachability->add_edge(from, to, grown)) {
+        return false;
+      }
+    }
 
-        if (successors.contains(to)) {
+    // only an edge into a vertex whose reachable set grew can newly close a
+    // cycle
+    for (auto a : grown) {
+      for (auto i = in_edge_offsets[a]; i < in_edge_offsets[a + 1]; i++) {
+        auto e = in_edges[i];
+        auto b = polygraph.edges[e].first;
+        if (!reachability->reaches(a, b)) {
           continue;
         }
 
-        successors.emplace(to);
-        get_successors(to);
+        auto justification = optional<expr_vector>{};
+        for (auto j = edge_var_offsets[e]; j < edge_var_offsets[e + 1]; j++) {
+          if (auto v = edge_vars[j]; !is_false[v]) {
+            if (!justification) {
+              justification = path_justification(a, b);
+            }
+            CHECKER_LOG_COND(trace, logger) {
+              logger << "propagate: " << polygraph.txn_id(b) << "->"
+                     << polygraph.txn_id(a) << " closes a cycle:";
+              for (const auto &v : *justification) {
+                logger << ' ' << v.to_string();
+              }
+              logger << " => !" << vars[v].to_string();
+            }
+
+            n_theory_propagations++;
+            n_justification_vars += justification->size();
+            set_false(v);
+            propagate(*justification, !vars[v]);
+          }
+        }
       }
-    };
+    }
 
-    get_successors(to);
+    return true;
+  }
 
-    for (auto e : edges) {
-      if (auto it = conflict_map.find(e); it != conflict_map.end()) {
-        for (auto &&v : it->second) {
-          conseq = conseq && !v;
+  /*
+   * The fixed variables on a path a->b in the reachability index, each once.
+   * The walk steps to any successor that still reaches b, preferring known
+   * edges, which need no justification.
+   */
+  auto path_justification(Vertex a, Vertex b) -> expr_vector {
+    auto path_vars = vector<uint32_t>{};
+    for (auto x = a; x != b;) {
+      auto next = x;
+      auto next_var = no_var;
+      for (auto e : utils::as_range(out_edges(x, dependency_graph))) {
+        if (auto y = target(e, dependency_graph);
+            reachability->reaches(y, b) && (next == x || next_var != 0)) {
+          next = y;
+          next_var = enabler[dependency_graph[e]];
+          if (next_var == 0) {
+            break;
+          }
         }
       }
+      assert(next != x);
+      path_vars.emplace_back(next_var);
+      x = next;
     }
 
-    // propagate(single(var) | utils::to<expr_vector>(ctx()), conseq);
+    return clause_of(path_vars);
   }
 
   ~DependencyGraphHasNoCycle() override {
     BOOST_LOG_TRIVIAL(debug) << "fixed() called " << n_fixed_called << " times";
+    BOOST_LOG_TRIVIAL(debug) << n_shared_edges << " of " << n_fixed_edges
+                             << " fixed edges were present already";
     BOOST_LOG_TRIVIAL(debug)
         << "found conflict " << n_conflicts_returned << " times";
     BOOST_LOG_TRIVIAL(debug)
@@ -509,7 +959,30 @@ struct DependencyGraphHasNoCycle : z3::user_propagator_base {
     BOOST_LOG_TRIVIAL(debug)
         << "avg. propagate var: "
         << static_cast<float>(n_propagate_vars) / n_propagate_called;
+    BOOST_LOG_TRIVIAL(debug) << "propagated " << n_theory_propagations
+                             << " variables to false";
+    BOOST_LOG_TRIVIAL(debug) << "avg. justification length: "
+                             << static_cast<float>(n_justification_vars) /
+                                    n_theory_propagations;
+    BOOST_LOG_TRIVIAL(debug) << "steered " << n_steered_decisions << " of "
+                             << n_decisions << " decisions";
   }
 };
 
+auto Solver::set_topological_decisions(bool enabled) -> void {
+  user_propagator->topological_decisions = enabled;
+}
+
+auto Solver::supports_topological_decisions() -> bool {
+  return CHECKER_Z3_HAS_DECIDE;
+}
+
+auto Solver::record_edges(vector<EdgeEvent> &events) -> void {
+  const auto &graph = user_propagator->dependency_graph;
+  for (auto e = 0_uz; e < num_edges(graph); e++) {
+    events.emplace_back(EdgeEvent::BASE, source(e, graph), target(e, graph));
+  }
+  user_propagator->edge_events = &events;
+}
+
 }  // namespace checker::solver
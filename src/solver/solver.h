@@ -3,6 +3,7 @@
 
 #include <z3++.h>
 
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -12,17 +13,72 @@
 namespace checker::solver {
 struct DependencyGraphHasNoCycle;
 
+/**
+ * The incremental cycle detection algorithm the solver checks fixed edges
+ * with, see utils/toposort.h.
+ */
+enum class CycleDetector { PEARCE_KELLY, ORDER_MAINTENANCE, TWO_WAY_SEARCH };
+
+/**
+ * A change to the solver's graph of fixed edges: BASE is an edge of the known
+ * graph, present before the search starts and never removed, ADD adds the
+ * edge from->to, CHECK checks the edges added since the previous CHECK for
+ * cycles, and REMOVE undoes the latest ADD not yet undone.
+ */
+struct EdgeEvent {
+  enum Type : uint8_t { BASE, ADD, CHECK, REMOVE };
+
+  Type type;
+  uint32_t from = 0;
+  uint32_t to = 0;
+};
+
 struct Solver {
-  z3::context context;
+  std::unique_ptr<z3::context> owned_context;
+  z3::context &context;
   z3::solver solver;
   std::unique_ptr<DependencyGraphHasNoCycle> user_propagator;
 
   Solver(const history::DependencyGraph &known_graph,
-         const std::vector<history::Constraint> &constraints);
+         const std::vector<history::Constraint> &constraints,
+         CycleDetector cycle_detector = CycleDetector::PEARCE_KELLY);
+
+  /**
+   * Encode into a caller-owned context, so that one context can be reused
+   * across histories. The context must outlive the solver and must not be
+   * used by another thread meanwhile.
+   */
+  Solver(const history::DependencyGraph &known_graph,
+         const std::vector<history::Constraint> &constraints,
+         z3::context &context,
+         CycleDetector cycle_detector = CycleDetector::PEARCE_KELLY);
 
   auto solve() -> bool;
 
+  /**
+   * Whether Z3's decisions on constraints are steered towards the side that
+   * agrees with the cycle detector's topological order; off by default. Only
+   * Z3 4.13 and later call the solver back on decisions, see
+   * supports_topological_decisions().
+   */
+  auto set_topological_decisions(bool enabled) -> void;
+
+  static auto supports_topological_decisions() -> bool;
+
+  /**
+   * Append the known edges the search starts from, then every edge it adds
+   * to or removes from its graph, to `events`, e.g. to replay the workload of
+   * the cycle detector. Call it before solve().
+   */
+  auto record_edges(std::vector<EdgeEvent> &events) -> void;
+
   ~Solver();
+
+ private:
+  Solver(const history::DependencyGraph &known_graph,
+         const std::vector<history::Constraint> &constraints,
+         std::unique_ptr<z3::context> owned_context,
+         z3::context *shared_context, CycleDetector cycle_detector);
 };
 }  // namespace checker::solver
 
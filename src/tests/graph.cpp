@@ -0,0 +1,276 @@
+#include <cstdint>
+#include <ranges>
+#include <sstream>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#include "history/dependencygraph.h"
+#include "history/history.h"
+#include "utils/bitmatrix.h"
+#include "utils/graph.h"
+#include "utils/to_container.h"
+#include "utils/trail_graph.h"
+
+#define BOOST_TEST_MODULE graph
+#include <boost/test/included/unit_test.hpp>
+
+using checker::history::EdgeType;
+using checker::history::Event;
+using checker::history::EventType;
+using checker::history::History;
+using checker::history::Session;
+using checker::history::Transaction;
+using checker::utils::to;
+using checker::utils::TrailGraph;
+using std::pair;
+using std::tuple;
+using std::vector;
+using std::ranges::sort;
+
+using Graph = checker::utils::Graph<uint32_t, int>;
+
+static auto sorted_edges(const Graph &graph) {
+  auto v = vector<tuple<uint32_t, uint32_t, int>>{};
+  for (const auto &[from, to, e] : graph.edges()) {
+    v.emplace_back(from, to, e.get());
+  }
+  sort(v);
+  return v;
+}
+
+BOOST_AUTO_TEST_CASE(bulk_build) {
+  auto graph = Graph{4, {{2, 1, 21}, {0, 3, 3}, {0, 1, 1}, {2, 0, 20}}};
+
+  BOOST_TEST(graph.num_vertices() == 4);
+  BOOST_TEST(graph.num_edges() == 4);
+  BOOST_TEST((graph.successors(0) | to<vector<uint32_t>>) ==
+             (vector<uint32_t>{1, 3}));
+  BOOST_TEST((graph.successors(1) | to<vector<uint32_t>>).empty());
+  BOOST_TEST((graph.successors(2) | to<vector<uint32_t>>) ==
+             (vector<uint32_t>{0, 1}));
+  BOOST_TEST(graph.edge(2, 1).value().get() == 21);
+  BOOST_TEST(!graph.edge(1, 2));
+  BOOST_TEST(!graph.vertex(4));
+}
+
+BOOST_AUTO_TEST_CASE(overlay) {
+  auto graph = Graph{3, {{0, 1, 1}}};
+  graph.add_edge(1, 2, 12);
+  graph.add_edge(0, 2, 2);
+
+  BOOST_TEST(graph.num_edges() == 3);
+  BOOST_TEST(graph.edge(0, 2).value().get() == 2);
+  BOOST_TEST(graph.edge(1, 2).value().get() == 12);
+  BOOST_TEST(!graph.edge(2, 0));
+  BOOST_TEST((graph.successors(0) | to<vector<uint32_t>>) ==
+             (vector<uint32_t>{1, 2}));
+
+  graph.edge(1, 2).value().get() = 120;
+  auto before = sorted_edges(graph);
+
+  graph.compact();
+  BOOST_TEST(graph.overlay_sources.empty());
+  BOOST_TEST(sorted_edges(graph) == before);
+  BOOST_TEST(graph.edge(1, 2).value().get() == 120);
+}
+
+BOOST_AUTO_TEST_CASE(closure) {
+  // 0 -> 1 -> 3, 0 -> 2 -> 3, 4 -> 0, 130 isolated, spanning several words
+  auto graph =
+      Graph{131, {{0, 1, 0}, {1, 3, 0}, {0, 2, 0}, {2, 3, 0}, {4, 0, 0}}};
+  auto closure = checker::utils::transitive_closure(
+      graph.num_vertices(), [&](auto v) { return graph.successors(v); }, 4);
+
+  BOOST_TEST_REQUIRE(closure.has_value());
+  auto reachable = [&](uint32_t v) {
+    auto r = vector<size_t>{};
+    closure->for_each_set(v, [&](size_t c) { r.emplace_back(c); });
+    return r;
+  };
+  BOOST_TEST(reachable(4) == (vector<size_t>{0, 1, 2, 3, 4}));
+  BOOST_TEST(reachable(2) == (vector<size_t>{2, 3}));
+  BOOST_TEST(reachable(130) == (vector<size_t>{130}));
+  BOOST_TEST(!closure->test(3, 0));
+
+  graph.add_edge(3, 4, 0);
+  BOOST_TEST(!checker::utils::transitive_closure(
+                  graph.num_vertices(),
+                  [&](auto v) { return graph.successors(v); }, 1)
+                  .has_value());
+}
+
+BOOST_AUTO_TEST_CASE(strongly_connected_components) {
+  // cycles 0 -> 1 -> 2 -> 0 and 3 <-> 4, joined by 2 -> 3; 5 -> 0 and 6 alone
+  auto graph = Graph{7,
+                     {{0, 1, 0},
+                      {1, 2, 0},
+                      {2, 0, 0},
+                      {2, 3, 0},
+                      {3, 4, 0},
+                      {4, 3, 0},
+                      {5, 0, 0}}};
+  auto scc = checker::utils::strongly_connected_components(
+      graph.num_vertices(), [&](auto v) { return graph.successors(v); });
+
+  BOOST_TEST_REQUIRE(scc.size() == 7);
+  BOOST_TEST((scc[0] == scc[1] && scc[1] == scc[2]));
+  BOOST_TEST(scc[3] == scc[4]);
+  BOOST_TEST(scc[0] != scc[3]);
+  BOOST_TEST(scc[5] != scc[0]);
+  BOOST_TEST(scc[6] != scc[5]);
+
+  // reverse topological order
+  for (const auto &[from, to, _] : graph.edges()) {
+    BOOST_TEST(scc[from] >= scc[to]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(trail_graph) {
+  // 0->1 may be present twice
+  auto capacity = vector<pair<uint32_t, uint32_t>>{{0, 1}, {0, 1}, {1, 2}};
+  auto graph = TrailGraph<uint32_t, int>{3, capacity};
+  auto out = [&](uint32_t v) {
+    auto [begin, end] = adjacent_vertices(v, graph);
+    return vector<uint32_t>(begin, end);
+  };
+  auto in = [&](uint32_t v) {
+    auto [begin, end] = in_edges(v, graph);
+    return vector<uint32_t>(begin, end);
+  };
+
+  auto e01 = graph.add_edge(0, 1, 1);
+  auto e12 = graph.add_edge(1, 2, 12);
+  BOOST_TEST(num_edges(graph) == 2);
+  BOOST_TEST(source(e12, graph) == 1);
+  BOOST_TEST(target(e12, graph) == 2);
+  BOOST_TEST(graph[e12] == 12);
+  BOOST_TEST(out(0) == (vector<uint32_t>{1}));
+  BOOST_TEST(in(2) == (vector<uint32_t>{e12}));
+
+  auto scope = num_edges(graph);
+  auto e01_again = graph.add_edge(0, 1, 2);
+  BOOST_TEST(out(0) == (vector<uint32_t>{1, 1}));
+  BOOST_TEST(in(1) == (vector<uint32_t>{e01, e01_again}));
+
+  graph.truncate(scope);
+  BOOST_TEST(num_edges(graph) == 2);
+  BOOST_TEST(in(1) == (vector<uint32_t>{e01}));
+
+  graph.truncate(0);
+  BOOST_TEST(out(0).empty());
+  BOOST_TEST(in(2).empty());
+
+  // slots are reused after an undo
+  graph.add_edge(0, 1, 3);
+  graph.add_edge(0, 1, 4);
+  BOOST_TEST(out(0) == (vector<uint32_t>{1, 1}));
+  BOOST_TEST(graph[1] == 4);
+}
+
+BOOST_AUTO_TEST_CASE(dependency_graph_merges_types) {
+  auto event = [](EventType type, int64_t key, int64_t value, int64_t txn) {
+    return Event{
+        .key = key,
+        .value = value,
+        .type = type,
+        .transaction_id = txn,
+    };
+  };
+  auto h = History{
+      .sessions = {
+          Session{
+              .id = 0,
+              .transactions = {
+                  Transaction{
+                      .id = 0,
+                      .events = {event(EventType::WRITE, 7, 1, 0)},
+                      .session_id = 0,
+                  },
+                  Transaction{
+                      .id = 1,
+                      .events = {event(EventType::READ, 7, 1, 1),
+                                 event(EventType::WRITE, 8, 2, 1)},
+                      .session_id = 0,
+                  },
+              },
+          },
+          Session{
+              .id = 1,
+              .transactions = {
+                  Transaction{
+                      .id = 2,
+                      .events = {event(EventType::READ, 8, 2, 2)},
+                      .session_id = 1,
+                  },
+              },
+          },
+      },
+  };
+
+  auto graph = checker::history::known_graph_of(h);
+  BOOST_TEST(graph.num_vertices() == 3);
+  BOOST_TEST(graph.num_edges() == 2);
+
+  const auto &e01 = graph.edge(0, 1).value().get();
+  BOOST_TEST((e01.has(EdgeType::SO) && e01.has(EdgeType::WR)));
+  BOOST_TEST(!e01.has(EdgeType::WW));
+  BOOST_TEST((graph.successors(1, EdgeType::WR) | to<vector<uint32_t>>) ==
+             (vector<uint32_t>{2}));
+  BOOST_TEST(
+      (graph.successors(1, EdgeType::SO) | to<vector<uint32_t>>).empty());
+  BOOST_TEST(std::ranges::distance(graph.wr()) == 2);
+  BOOST_TEST(std::ranges::distance(graph.so()) == 1);
+
+  graph.add_edge(2, 0, {.type = EdgeType::RW, .keys = {0}});
+  graph.add_edge(2, 0, {.type = EdgeType::WW, .keys = {1}});
+  BOOST_TEST(graph.num_edges() == 3);
+  BOOST_TEST((graph.edge(2, 0).value().get().types ==
+              (checker::history::edge_type_bit(EdgeType::RW) |
+               checker::history::edge_type_bit(EdgeType::WW))));
+}
+
+BOOST_AUTO_TEST_CASE(dependency_graph_prints_history_ids) {
+  auto event = [](EventType type, int64_t key, int64_t value, int64_t txn) {
+    return Event{
+        .key = key,
+        .value = value,
+        .type = type,
+        .transaction_id = txn,
+    };
+  };
+  auto h = History{
+      .sessions = {
+          Session{
+              .id = 3,
+              .transactions = {
+                  Transaction{
+                      .id = 10,
+                      .events = {event(EventType::WRITE, 7, 1, 10)},
+                      .session_id = 3,
+                  },
+                  Transaction{
+                      .id = 11,
+                      .events = {event(EventType::READ, 7, 1, 11),
+                                 event(EventType::WRITE, 8, 2, 11)},
+                      .session_id = 3,
+                  },
+              },
+          },
+          Session{
+              .id = 4,
+              .transactions = {
+                  Transaction{
+                      .id = 20,
+                      .events = {event(EventType::READ, 8, 2, 20)},
+                      .session_id = 4,
+                  },
+              },
+          },
+      },
+  };
+
+  auto os = std::ostringstream{};
+  os << checker::history::known_graph_of(h);
+  BOOST_TEST(os.str() == "10->11 SO+WR(7)\n11->20 WR(8)\n");
+}
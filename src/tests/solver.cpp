@@ -1,7 +1,9 @@
 #include <z3++.h>
 
+#include <algorithm>
 #include <cstdint>
 #include <ranges>
+#include <sstream>
 #include <tuple>
 #include <unordered_map>
 #include <unordered_set>
@@ -11,7 +13,10 @@
 #include "history/constraint.h"
 #include "history/dependencygraph.h"
 #include "history/history.h"
+#include "solver/components.h"
+#include "solver/greedy.h"
 #include "solver/pruner.h"
+#include "solver/reachability.h"
 #include "solver/solver.h"
 #include "utils/log.h"
 #include "utils/to_container.h"
@@ -36,7 +41,7 @@ using std::ranges::views::transform;
 
 static auto check_history(const History &h) {
   auto depgraph = checker::history::known_graph_of(h);
-  auto cons = checker::history::constraints_of(h, depgraph.wr);
+  auto cons = checker::history::constraints_of(h, depgraph);
 
   CHECKER_LOG_COND(trace, logger) {
     logger << "history:\n"
@@ -461,3 +466,336 @@ BOOST_AUTO_TEST_CASE(pruning) {
 
   BOOST_TEST(check_history(h));
 }
+
+BOOST_AUTO_TEST_CASE(cyclic_known_graph) {
+  // 0 and 1 read from each other
+  auto h = create_history(
+      {
+          {0, {0}},
+          {1, {1}},
+      },
+      {
+          {0,
+           {
+               {READ, 2, 2},
+               {WRITE, 1, 1},
+           }},
+          {1,
+           {
+               {READ, 1, 1},
+               {WRITE, 2, 2},
+           }},
+      });
+
+  // the solver sees the cycle without pruning too
+  auto depgraph = checker::history::known_graph_of(h);
+  auto cons = checker::history::constraints_of(h, depgraph);
+  auto solver = checker::solver::Solver{depgraph, cons};
+  BOOST_TEST(!solver.solve());
+}
+
+BOOST_AUTO_TEST_CASE(greedy_serialization) {
+  // 1 and 2 overwrite 0 and 3 reads from 2, so 0, 1, 2, 3 is a serialization
+  auto h = create_history(
+      {
+          {0, {0}},
+          {1, {1}},
+          {2, {2, 3}},
+      },
+      {
+          {0,
+           {
+               {WRITE, 1, 1},
+           }},
+          {1,
+           {
+               {WRITE, 1, 2},
+           }},
+          {2,
+           {
+               {WRITE, 1, 3},
+           }},
+          {3,
+           {
+               {READ, 1, 3},
+           }},
+      });
+
+  auto depgraph = checker::history::known_graph_of(h);
+  auto cons = checker::history::constraints_of(h, depgraph);
+  BOOST_TEST(!cons.empty());
+  BOOST_TEST(checker::solver::greedy_serialization(depgraph, cons));
+  BOOST_TEST(check_history(h));
+
+  // 1 and 2 both overwrite what they read from 0, so no serialization exists
+  auto lost_update = create_history(
+      {
+          {0, {0}},
+          {1, {1}},
+          {2, {2}},
+      },
+      {
+          {0,
+           {
+               {WRITE, 1, 1},
+           }},
+          {1,
+           {
+               {READ, 1, 1},
+               {WRITE, 1, 2},
+           }},
+          {2,
+           {
+               {READ, 1, 1},
+               {WRITE, 1, 3},
+           }},
+      });
+
+  depgraph = checker::history::known_graph_of(lost_update);
+  cons = checker::history::constraints_of(lost_update, depgraph);
+  BOOST_TEST(!checker::solver::greedy_serialization(depgraph, cons));
+  BOOST_TEST(!check_history(lost_update));
+}
+
+BOOST_AUTO_TEST_CASE(eliminate_outside_cycles) {
+  // the writers of key 1 are tied together by SO and WR edges, while 3 and 4
+  // only share key 2, so the sole cycle through them needs both sides of
+  // their constraint
+  auto h = create_history(
+      {
+          {0, {0, 1}},
+          {1, {2}},
+          {2, {3}},
+          {3, {4}},
+      },
+      {
+          {0,
+           {
+               {WRITE, 1, 1},
+           }},
+          {1,
+           {
+               {READ, 1, 1},
+               {WRITE, 1, 2},
+           }},
+          {2,
+           {
+               {READ, 1, 2},
+               {WRITE, 1, 3},
+           }},
+          {3,
+           {
+               {WRITE, 2, 1},
+           }},
+          {4,
+           {
+               {WRITE, 2, 2},
+           }},
+      });
+
+  auto depgraph = checker::history::known_graph_of(h);
+  auto cons = checker::history::constraints_of(h, depgraph);
+  auto n_constraints = cons.size();
+  checker::solver::eliminate_outside_cycles(depgraph, cons);
+  BOOST_TEST(cons.size() == n_constraints - 1);
+
+  // eliminating keeps the verdict
+  auto accept = checker::solver::Solver{depgraph, cons}.solve();
+  BOOST_TEST(accept);
+  BOOST_TEST(check_history(h));
+}
+
+BOOST_AUTO_TEST_CASE(split_components) {
+  // sessions 0 and 1 only use key 1, sessions 2 and 3 only key 2
+  auto h = create_history(
+      {
+          {0, {0, 1}},
+          {1, {2}},
+          {2, {3, 4}},
+          {3, {5}},
+      },
+      {
+          {0,
+           {
+               {WRITE, 1, 1},
+           }},
+          {1,
+           {
+               {READ, 1, 1},
+           }},
+          {2,
+           {
+               {WRITE, 1, 2},
+           }},
+          {3,
+           {
+               {WRITE, 2, 1},
+           }},
+          {4,
+           {
+               {READ, 2, 1},
+           }},
+          {5,
+           {
+               {WRITE, 2, 2},
+           }},
+      });
+
+  auto depgraph = checker::history::known_graph_of(h);
+  auto cons = checker::history::constraints_of(h, depgraph);
+  BOOST_TEST(cons.size() == 2);
+
+  auto components =
+      checker::solver::split_components(std::move(depgraph), std::move(cons));
+  BOOST_TEST_REQUIRE(components.size() == 2);
+  for (const auto &component : components) {
+    BOOST_TEST(component.constraints.size() == 1);
+    BOOST_TEST(std::ranges::is_sorted(component.vertices));
+    for (const auto &c : component.constraints) {
+      BOOST_TEST(c.either_txn_id < c.or_txn_id);
+      BOOST_TEST(c.or_txn_id < component.vertices.size());
+    }
+  }
+  BOOST_TEST((components[0].vertices == vector<uint32_t>{0, 1, 2}));
+  BOOST_TEST((components[1].vertices == vector<uint32_t>{3, 4, 5}));
+
+  // the components agree with the whole history
+  auto components_accept =
+      std::ranges::all_of(components, [](const auto &component) {
+        return checker::solver::Solver{component.dependency_graph,
+                                       component.constraints}
+            .solve();
+      });
+  BOOST_TEST(components_accept);
+  BOOST_TEST(check_history(h));
+}
+
+BOOST_AUTO_TEST_CASE(parallel_constraints) {
+  auto h = create_history(
+      {
+          {0, {0, 1}},
+          {1, {2, 3}},
+      },
+      {
+          {0,
+           {
+               {WRITE, 1, 1},
+               {WRITE, 2, 1},
+           }},
+          {1,
+           {
+               {READ, 1, 1},
+               {WRITE, 1, 2},
+           }},
+          {2,
+           {
+               {READ, 2, 1},
+               {WRITE, 2, 3},
+               {WRITE, 1, 3},
+           }},
+          {3,
+           {
+               {READ, 1, 3},
+               {READ, 2, 3},
+           }},
+      });
+
+  auto depgraph = checker::history::known_graph_of(h);
+  auto to_string = [](const vector<checker::history::Constraint> &cons) {
+    auto os = std::ostringstream{};
+    for (const auto &c : cons) {
+      os << c;
+    }
+    return os.str();
+  };
+
+  auto cons = checker::history::constraints_of(h, depgraph, 1);
+  BOOST_TEST(cons.size() == 3);
+  BOOST_TEST(to_string(cons) ==
+             to_string(checker::history::constraints_of(h, depgraph, 4)));
+
+  for (const auto &c : cons) {
+    const auto &[from, to, info] = c.either_edges.front();
+    BOOST_TEST(c.either_txn_id < c.or_txn_id);
+    BOOST_TEST((from == c.either_txn_id && to == c.or_txn_id));
+    BOOST_TEST((info.type == checker::history::EdgeType::WW));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(reachability_indices) {
+  using checker::history::EdgeType;
+
+  // sessions 0->1->2, 3->4 and 5, with WR edges 1->3 and 4->5
+  auto depgraph = checker::history::DependencyGraph{
+      .graph = checker::history::DependencyGraph::Graph{6},
+  };
+  for (auto [from, to, type] : vector<tuple<uint32_t, uint32_t, EdgeType>>{
+           {0, 1, EdgeType::SO},
+           {1, 2, EdgeType::SO},
+           {3, 4, EdgeType::SO},
+           {1, 3, EdgeType::WR},
+           {4, 5, EdgeType::WR},
+       }) {
+    depgraph.add_edge(from, to, {.type = type, .keys = {0}});
+  }
+
+  auto matrix = checker::solver::MatrixReachability::of(depgraph, 1);
+  auto clocks = checker::solver::SessionClockReachability::of(
+      depgraph, checker::solver::SessionChains::of(depgraph));
+  BOOST_REQUIRE(matrix);
+  BOOST_REQUIRE(clocks);
+  BOOST_TEST(clocks->chains.num_chains() == 3);
+
+  auto agree = [&] {
+    for (auto from = uint32_t{0}; from < 6; from++) {
+      for (auto to = uint32_t{0}; to < 6; to++) {
+        if (matrix->reaches(from, to) != clocks->reaches(from, to)) {
+          return false;
+        }
+      }
+    }
+    return true;
+  };
+
+  BOOST_TEST(agree());
+  BOOST_TEST(clocks->reaches(0, 5));
+  BOOST_TEST(!clocks->reaches(2, 3));
+
+  for (auto [from, to] :
+       vector<std::pair<uint32_t, uint32_t>>{{2, 3}, {5, 2}, {5, 0}}) {
+    BOOST_TEST(matrix->add_edge(from, to) == clocks->add_edge(from, to));
+    BOOST_TEST(agree());
+  }
+  BOOST_TEST(clocks->reaches(2, 5));
+  BOOST_TEST(!clocks->add_edge(5, 0));
+}
+
+BOOST_AUTO_TEST_CASE(reachability_undo) {
+  using checker::history::EdgeType;
+
+  // sessions 0->1 and 2->3
+  auto depgraph = checker::history::DependencyGraph{
+      .graph = checker::history::DependencyGraph::Graph{4},
+  };
+  depgraph.add_edge(0, 1, {.type = EdgeType::SO, .keys = {0}});
+  depgraph.add_edge(2, 3, {.type = EdgeType::SO, .keys = {0}});
+
+  auto clocks = checker::solver::SessionClockReachability::of(
+      depgraph, checker::solver::SessionChains::of(depgraph));
+  BOOST_REQUIRE(clocks);
+  clocks->record_undo = true;
+  auto before = *clocks;
+
+  BOOST_TEST(clocks->add_edge(1, 2));
+  auto mark = clocks->undo_log.size();
+  BOOST_TEST(clocks->add_edge(3, 0) == false);
+  BOOST_TEST(clocks->undo_log.size() == mark);
+  BOOST_TEST(clocks->reaches(0, 3));
+
+  clocks->undo(0);
+  BOOST_TEST(!clocks->reaches(0, 3));
+  BOOST_TEST(clocks->first == before.first);
+  BOOST_TEST(clocks->reached_by_end == before.reached_by_end);
+  BOOST_TEST(clocks->add_edge(3, 0));
+  BOOST_TEST(clocks->reaches(2, 1));
+}
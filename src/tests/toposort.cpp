@@ -1,22 +1,30 @@
 #include <algorithm>
 #include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/topological_sort.hpp>
+#include <boost/mpl/list.hpp>
 #include <cassert>
 #include <cstddef>
+#include <cstdint>
 #include <initializer_list>
 #include <iterator>
+#include <list>
 #include <memory>
+#include <random>
 #include <ranges>
+#include <stdexcept>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
 #include "utils/to_container.h"
 #include "utils/toposort.h"
+#include "utils/trail_graph.h"
 
 #define BOOST_TEST_MODULE toposort
 #include <boost/test/included/unit_test.hpp>
 
 using boost::add_edge;
+using checker::utils::as_range;
 using checker::utils::to;
 using checker::utils::TopologicalOrder;
 using std::array;
@@ -29,11 +37,24 @@ using std::ranges::range;
 using std::ranges::reverse;
 using std::ranges::views::filter;
 
-using Graph = boost::adjacency_list<>;
+using Graph = boost::adjacency_list<boost::vecS, boost::vecS,
+                                    boost::bidirectionalS>;
 using Vertex = Graph::vertex_descriptor;
 using Edge = Graph::edge_descriptor;
+using ShortestCycleAlgorithms =
+    boost::mpl::list<checker::utils::PearceKelly<Graph>,
+                     checker::utils::OrderMaintenance<Graph>>;
+using Algorithms = boost::mpl::list<checker::utils::PearceKelly<Graph>,
+                                    checker::utils::OrderMaintenance<Graph>,
+                                    checker::utils::TwoWaySearch<Graph>>;
 static_assert(std::is_same_v<Vertex, size_t>);
 
+using TrailGraph = checker::utils::TrailGraph<uint32_t, size_t>;
+using TrailGraphAlgorithms =
+    boost::mpl::list<checker::utils::PearceKelly<TrailGraph>,
+                     checker::utils::OrderMaintenance<TrailGraph>,
+                     checker::utils::TwoWaySearch<TrailGraph>>;
+
 static auto create_graph(size_t num_vertices,
                          initializer_list<pair<Vertex, Vertex>> edges)
     -> pair<std::unique_ptr<Graph>,
@@ -89,9 +110,229 @@ BOOST_AUTO_TEST_CASE(toposort) {
   BOOST_TEST(cycle_equal(d.check_add_edge(e3).value(), {2, 3, 4}, *g));
 }
 
-BOOST_AUTO_TEST_CASE(minimal_cycle) {
-  auto [g, d] = create_graph(5, {{0, 1}, {0, 2}, {1, 4}, {2, 3}, {3, 4}});
+BOOST_AUTO_TEST_CASE_TEMPLATE(minimal_cycle, Algorithm,
+                              ShortestCycleAlgorithms) {
+  auto g = std::make_unique<Graph>(5);
+  auto d = checker::utils::IncrementalCycleDetector<Graph, Algorithm>{*g};
+  for (auto [from, to] :
+       initializer_list<pair<Vertex, Vertex>>{
+           {0, 1}, {0, 2}, {1, 4}, {2, 3}, {3, 4}}) {
+    BOOST_TEST(!d.check_add_edge(add_edge(from, to, *g).first));
+  }
 
   auto e = add_edge(4, 0, *g).first;
   BOOST_TEST(cycle_equal(d.check_add_edge(e).value(), {0, 1, 4}, *g));
 }
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(random_insertions, Algorithm, Algorithms) {
+  constexpr auto n = 40_uz;
+  auto g = std::make_unique<Graph>(n);
+  auto d = checker::utils::IncrementalCycleDetector<Graph, Algorithm>{*g};
+  auto rng = std::mt19937{42};
+  auto vertex = std::uniform_int_distribution<Vertex>{0, n - 1};
+  auto added = vector<Edge>{};
+
+  auto reaches = [&](Vertex from, Vertex to) {
+    auto seen = vector<bool>(n);
+    auto stack = vector{from};
+    seen[from] = true;
+    while (!stack.empty()) {
+      auto v = stack.back();
+      stack.pop_back();
+      if (v == to) {
+        return true;
+      }
+      for (auto v2 : as_range(boost::adjacent_vertices(v, *g))) {
+        if (!seen[v2]) {
+          seen[v2] = true;
+          stack.emplace_back(v2);
+        }
+      }
+    }
+    return false;
+  };
+
+  for (auto i = 0; i < 1000; i++) {
+    // now and then, remove the latest edges as the solver does on backtrack
+    if (i % 10 == 9) {
+      for (auto j = 0; j < 3 && !added.empty(); j++) {
+        boost::remove_edge(added.back(), *g);
+        added.pop_back();
+      }
+    }
+
+    auto from = vertex(rng);
+    auto to = vertex(rng);
+    auto has_cycle = reaches(to, from);
+    auto e = add_edge(from, to, *g).first;
+    auto cycle = d.check_add_edge(e);
+    BOOST_TEST(cycle.has_value() == has_cycle);
+
+    if (cycle) {
+      BOOST_TEST(cycle->back() == e);
+      for (auto j = 0_uz; j < cycle->size(); j++) {
+        BOOST_TEST(boost::target(cycle->at(j), *g) ==
+                   boost::source(cycle->at((j + 1) % cycle->size()), *g));
+      }
+      boost::remove_edge(e, *g);
+    } else {
+      added.emplace_back(e);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(random_batches, Algorithm, Algorithms) {
+  constexpr auto n = 40_uz;
+  auto g = std::make_unique<Graph>(n);
+  auto d = checker::utils::IncrementalCycleDetector<Graph, Algorithm>{*g};
+  auto rng = std::mt19937{7};
+  auto vertex = std::uniform_int_distribution<Vertex>{0, n - 1};
+  auto batch_size = std::uniform_int_distribution<size_t>{1, 4};
+
+  auto is_dag = [&] {
+    try {
+      auto order = vector<Vertex>{};
+      boost::topological_sort(*g, std::back_inserter(order));
+      return true;
+    } catch (const boost::not_a_dag &) {
+      return false;
+    }
+  };
+
+  for (auto i = 0; i < 300; i++) {
+    auto batch = vector<Edge>{};
+    for (auto j = batch_size(rng); j > 0; j--) {
+      batch.emplace_back(add_edge(vertex(rng), vertex(rng), *g).first);
+    }
+
+    auto has_cycle = !is_dag();
+    auto cycle = d.check_add_edges(batch);
+    BOOST_TEST(cycle.has_value() == has_cycle);
+    if (cycle) {
+      for (auto j = 0_uz; j < cycle->size(); j++) {
+        BOOST_TEST(boost::target(cycle->at(j), *g) ==
+                   boost::source(cycle->at((j + 1) % cycle->size()), *g));
+      }
+      for (const auto &e : batch) {
+        boost::remove_edge(e, *g);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(trail_graph_backtracking, Algorithm,
+                              TrailGraphAlgorithms) {
+  constexpr auto n = uint32_t{40};
+  auto rng = std::mt19937{11};
+  auto vertex = std::uniform_int_distribution<uint32_t>{0, n - 1};
+
+  // any of the edges may be present at once
+  auto edges = vector<pair<uint32_t, uint32_t>>{};
+  for (auto i = 0; i < 1000; i++) {
+    edges.emplace_back(vertex(rng), vertex(rng));
+  }
+  auto g = TrailGraph{n, edges};
+  auto d = checker::utils::IncrementalCycleDetector<TrailGraph, Algorithm>{g};
+  auto scopes = vector<size_t>{};
+
+  auto reaches = [&](uint32_t from, uint32_t to) {
+    auto seen = vector<bool>(n);
+    auto stack = vector{from};
+    seen[from] = true;
+    while (!stack.empty()) {
+      auto v = stack.back();
+      stack.pop_back();
+      if (v == to) {
+        return true;
+      }
+      for (auto v2 : as_range(adjacent_vertices(v, g))) {
+        if (!seen[v2]) {
+          seen[v2] = true;
+          stack.emplace_back(v2);
+        }
+      }
+    }
+    return false;
+  };
+
+  for (auto i = 0_uz; i < edges.size(); i++) {
+    // open a scope now and then, and backtrack over half of them
+    if (i % 3 == 0) {
+      scopes.emplace_back(num_edges(g));
+    }
+    if (i % 10 == 9) {
+      g.truncate(scopes[scopes.size() / 2]);
+      scopes.resize(scopes.size() / 2);
+    }
+
+    auto [from, to] = edges[i];
+    auto has_cycle = reaches(to, from);
+    auto e = g.add_edge(from, to, i);
+    auto cycle = d.check_add_edge(e);
+    BOOST_TEST(cycle.has_value() == has_cycle);
+
+    if (cycle) {
+      BOOST_TEST(g[cycle->back()] == i);
+      for (auto j = 0_uz; j < cycle->size(); j++) {
+        BOOST_TEST(target(cycle->at(j), g) ==
+                   source(cycle->at((j + 1) % cycle->size()), g));
+      }
+      g.remove_last_edge();
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE_TEMPLATE(base_layer, Algorithm, TrailGraphAlgorithms) {
+  constexpr auto n = uint32_t{4};
+
+  // a base path 3->2->1->0, against the identity order
+  auto edges = vector<pair<uint32_t, uint32_t>>{{3, 2}, {2, 1}, {1, 0},
+                                                {0, 3}, {3, 0}, {1, 2}};
+  auto g = TrailGraph{n, edges};
+  for (auto i = 0_uz; i < 3; i++) {
+    g.add_edge(edges[i].first, edges[i].second, i);
+  }
+  auto d = checker::utils::IncrementalCycleDetector<TrailGraph, Algorithm>{g};
+  for (auto i = 0_uz; i < 3; i++) {
+    BOOST_TEST(d.before(edges[i].first, edges[i].second));
+  }
+
+  for (auto i = 3_uz; i < edges.size(); i++) {
+    auto e = g.add_edge(edges[i].first, edges[i].second, i);
+    auto cycle = d.check_add_edge(e);
+    BOOST_TEST(cycle.has_value() == (i != 4));
+    if (cycle) {
+      BOOST_TEST(g[cycle->back()] == i);
+      g.remove_last_edge();
+    }
+  }
+
+  g.add_edge(0, 3, 3);
+  BOOST_CHECK_THROW(
+      (checker::utils::IncrementalCycleDetector<TrailGraph, Algorithm>{g}),
+      std::invalid_argument);
+}
+
+BOOST_AUTO_TEST_CASE(order_list_relabels) {
+  constexpr auto n = 8_uz;
+  auto order = checker::utils::OrderList<Vertex>{
+      std::ranges::views::iota(0_uz, n)};
+  auto expected = std::list<Vertex>{};
+  for (auto v = 0_uz; v < n; v++) {
+    expected.emplace_back(v);
+  }
+
+  // halves the same gap each time, so labels run out within 62 moves
+  for (auto i = 0_uz; i < 1000; i++) {
+    auto v = 1 + i % (n - 1);
+    order.move_after(v, 0);
+    expected.remove(v);
+    expected.insert(std::next(expected.begin()), v);
+  }
+
+  auto vertices = order.vertices();
+  BOOST_TEST(equal(vertices, expected));
+  for (auto i = 1_uz; i < vertices.size(); i++) {
+    BOOST_TEST(order.before(vertices[i - 1], vertices[i]));
+  }
+}
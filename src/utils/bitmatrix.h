@@ -0,0 +1,221 @@
+#ifndef CHECKER_UTILS_BITMATRIX_H
+#define CHECKER_UTILS_BITMATRIX_H
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <optional>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "graph.h"
+#include "parallel.h"
+
+namespace checker::utils {
+
+namespace detail {
+
+using RowOr = void (*)(uint64_t *dst, const uint64_t *src, size_t words);
+
+inline auto row_or_scalar(uint64_t *dst, const uint64_t *src, size_t words)
+    -> void {
+  for (auto i = size_t{0}; i < words; i++) {
+    dst[i] |= src[i];
+  }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// rows are 64-byte aligned and a multiple of 64 bytes long, see BitMatrix
+__attribute__((target("avx2"))) inline auto row_or_avx2(uint64_t *dst,
+                                                        const uint64_t *src,
+                                                        size_t words) -> void {
+  for (auto i = size_t{0}; i < words; i += 4) {
+    auto d = reinterpret_cast<__m256i *>(dst + i);
+    auto s = reinterpret_cast<const __m256i *>(src + i);
+    _mm256_store_si256(d, _mm256_or_si256(_mm256_load_si256(d),
+                                          _mm256_load_si256(s)));
+  }
+}
+
+__attribute__((target("avx512f"))) inline auto row_or_avx512(
+    uint64_t *dst, const uint64_t *src, size_t words) -> void {
+  for (auto i = size_t{0}; i < words; i += 8) {
+    auto d = dst + i;
+    auto s = src + i;
+    _mm512_store_si512(d, _mm512_or_si512(_mm512_load_si512(d),
+                                          _mm512_load_si512(s)));
+  }
+}
+#endif
+
+inline auto select_row_or() -> RowOr {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f")) {
+    return row_or_avx512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return row_or_avx2;
+  }
+#endif
+  return row_or_scalar;
+}
+
+// picked once for the CPU we run on
+inline const auto row_or = select_row_or();
+
+struct AlignedDelete {
+  auto operator()(uint64_t *p) const -> void {
+    ::operator delete[](p, std::align_val_t{64});
+  }
+};
+
+}  // namespace detail
+
+/**
+ * A dense bit matrix. Each row is 64-byte aligned and padded to a multiple of
+ * 64 bytes, so rows can be ORed with full-width vector instructions; the
+ * widest kernel the CPU supports is picked at startup.
+ */
+struct BitMatrix {
+  static constexpr auto row_alignment = size_t{64};
+  static constexpr auto words_per_block = row_alignment / sizeof(uint64_t);
+
+  size_t rows = 0;
+  size_t cols = 0;
+  size_t stride = 0;  // words per row
+  std::unique_ptr<uint64_t[], detail::AlignedDelete> words;
+
+  BitMatrix() = default;
+
+  BitMatrix(size_t rows, size_t cols)
+      : rows{rows},
+        cols{cols},
+        stride{(cols + 64 * words_per_block - 1) / (64 * words_per_block) *
+               words_per_block},
+        words{static_cast<uint64_t *>(
+            ::operator new[](std::max<size_t>(rows * stride, 1) *
+                                 sizeof(uint64_t),
+                             std::align_val_t{row_alignment}))} {
+    std::fill_n(words.get(), rows * stride, 0);
+  }
+
+  auto row(size_t r) -> uint64_t * { return words.get() + r * stride; }
+
+  auto row(size_t r) const -> const uint64_t * {
+    return words.get() + r * stride;
+  }
+
+  auto test(size_t r, size_t c) const -> bool {
+    return row(r)[c / 64] >> (c % 64) & 1;
+  }
+
+  auto set(size_t r, size_t c) -> void {
+    row(r)[c / 64] |= uint64_t{1} << (c % 64);
+  }
+
+  /*
+   * Row dst |= row src of `other`, which must have as many columns.
+   */
+  auto or_row(size_t dst, const BitMatrix &other, size_t src) -> void {
+    detail::row_or(row(dst), other.row(src), stride);
+  }
+
+  auto or_row(size_t dst, size_t src) -> void { or_row(dst, *this, src); }
+
+  /*
+   * Call f(c) for every set column c of a row, in increasing order.
+   */
+  template <typename F>
+  auto for_each_set(size_t r, F &&f) const -> void {
+    const auto *p = row(r);
+    for (auto w = size_t{0}; w < stride; w++) {
+      for (auto bits = p[w]; bits != 0; bits &= bits - 1) {
+        f(w * 64 + std::countr_zero(bits));
+      }
+    }
+  }
+};
+
+/**
+ * Transitive closure of a directed graph over [0, n): row v is the set of
+ * vertices reachable from v, including v. Returns nullopt if the graph has a
+ * cycle.
+ *
+ * Vertices are grouped by level, the length of the longest path from them to
+ * a sink. A row only depends on rows of lower levels, so the rows of a level
+ * are computed in parallel on `threads` threads once the level is large
+ * enough to pay for it.
+ */
+template <typename Successors>
+auto transitive_closure(size_t n, Successors &&successors, size_t threads)
+    -> std::optional<BitMatrix> {
+  constexpr auto min_parallel_level = size_t{256};
+
+  auto order = topological_sort(n, successors);
+  if (!order) {
+    return std::nullopt;
+  }
+
+  // bucket the vertices by level
+  auto level = std::vector<uint32_t>(n);
+  auto num_levels = size_t{0};
+  for (auto it = order->rbegin(); it != order->rend(); it++) {
+    for (auto v2 : successors(*it)) {
+      level[*it] = std::max(level[*it], level[v2] + 1);
+    }
+    num_levels = std::max<size_t>(num_levels, level[*it] + 1);
+  }
+
+  auto level_offsets = std::vector<uint32_t>(num_levels + 1);
+  for (auto v = size_t{0}; v < n; v++) {
+    level_offsets[level[v] + 1]++;
+  }
+  for (auto l = size_t{0}; l < num_levels; l++) {
+    level_offsets[l + 1] += level_offsets[l];
+  }
+
+  auto by_level = std::vector<uint32_t>(n);
+  auto level_end = std::vector<uint32_t>(level_offsets.begin(),
+                                         level_offsets.end() - 1);
+  for (auto v : *order) {
+    by_level[level_end[level[v]]++] = v;
+  }
+
+  auto closure = BitMatrix{n, n};
+  auto compute_row = [&](uint32_t v) {
+    closure.set(v, v);
+    for (auto v2 : successors(v)) {
+      if (!closure.test(v, v2)) {
+        closure.or_row(v, v2);
+      }
+    }
+  };
+
+  for (auto l = size_t{0}; l < num_levels; l++) {
+    auto begin = level_offsets[l];
+    auto size = level_offsets[l + 1] - begin;
+
+    if (threads <= 1 || size < min_parallel_level) {
+      for (auto i = begin; i < begin + size; i++) {
+        compute_row(by_level[i]);
+      }
+    } else {
+      parallel_for(
+          size, threads,
+          [&](size_t i, size_t) { compute_row(by_level[begin + i]); }, 64);
+    }
+  }
+
+  return closure;
+}
+
+}  // namespace checker::utils
+
+#endif  // CHECKER_UTILS_BITMATRIX_H
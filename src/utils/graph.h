@@ -1,70 +1,140 @@
 #ifndef CHECKER_UTILS_GRAPH_H
 #define CHECKER_UTILS_GRAPH_H
 
-#include <boost/bimap.hpp>
-#include <boost/bimap/unordered_set_of.hpp>
-#include <boost/graph/adjacency_list.hpp>
+#include <algorithm>
+#include <cassert>
 #include <concepts>
 #include <cstddef>
+#include <cstdint>
 #include <functional>
 #include <iosfwd>
-#include <memory>
+#include <iterator>
+#include <limits>
+#include <numeric>
 #include <optional>
 #include <ranges>
 #include <syncstream>
-#include <unordered_map>
+#include <tuple>
 #include <utility>
-
-#include "boost/container_hash/extensions.hpp"
+#include <vector>
 
 namespace checker::utils {
-template <typename T>
-concept HashAndEquality = requires(T t) {
-  { std::hash<T>{}(t) } -> std::same_as<size_t>;
-  { std::equal_to<T>{}(t, t) } -> std::same_as<bool>;
-};
 
-template <HashAndEquality Vertex, typename Edge>
+/**
+ * A directed graph over dense vertex ids [0, num_vertices()) in compressed
+ * sparse row form.
+ *
+ * Edges are identified by a dense index. Their targets and payloads are
+ * stored in parallel arrays. The edges given to the constructor are laid
+ * out by source vertex, so the out-edges of v are the index range
+ * [offsets[v], offsets[v + 1]), sorted by target. Edges added later with
+ * add_edge() go to an overlay past offsets.back(), chained per source
+ * vertex. compact() merges the overlay back into the rows.
+ *
+ * There is at most one edge between each ordered pair of vertices.
+ */
+template <std::unsigned_integral Vertex, typename Edge>
 struct Graph {
-  using InternalGraph =
-      boost::adjacency_list<boost::vecS, boost::vecS, boost::bidirectionalS>;
-
-  std::unique_ptr<InternalGraph> graph = std::make_unique<InternalGraph>();
-  boost::bimap<
-      boost::bimaps::unordered_set_of<Vertex, std::hash<Vertex>>,
-      boost::bimaps::unordered_set_of<InternalGraph::vertex_descriptor>>
-      vertex_map;
-  std::unordered_map<InternalGraph::edge_descriptor, Edge,
-                     boost::hash<InternalGraph::edge_descriptor>>
-      edge_map;
-
-  auto add_vertex(Vertex v) -> const Vertex & {
-    return vertex_map.insert({v, boost::add_vertex(*graph)})
-        .first->get_left_pair()
-        .first;
-  }
-
-  auto vertex(Vertex v) const
-      -> std::optional<std::reference_wrapper<const Vertex>> {
-    if (auto it = vertex_map.left.find(v); it != vertex_map.left.end()) {
-      return std::ref(it->first);
+  using EdgeIndex = uint32_t;
+  static constexpr auto no_edge = std::numeric_limits<EdgeIndex>::max();
+
+  std::vector<EdgeIndex> offsets{0};
+  std::vector<Vertex> targets;
+  std::vector<Edge> payloads;
+
+  // overlay edge i has index offsets.back() + i
+  std::vector<Vertex> overlay_sources;
+  std::vector<EdgeIndex> overlay_next;
+  std::vector<EdgeIndex> overlay_head;  // empty until the first add_edge()
+
+  Graph() = default;
+
+  explicit Graph(size_t num_vertices) : offsets(num_vertices + 1, 0) {}
+
+  Graph(size_t num_vertices,
+        std::vector<std::tuple<Vertex, Vertex, Edge>> edges)
+      : offsets(num_vertices + 1, 0) {
+    assert(edges.size() < no_edge);
+
+    // counting sort by source, then sort each row by target
+    for (const auto &[from, to, _] : edges) {
+      offsets.at(from + 1)++;
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    auto order = std::vector<EdgeIndex>(edges.size());
+    auto row_end = std::vector<EdgeIndex>(offsets.begin(), offsets.end() - 1);
+    for (auto i = EdgeIndex{0}; i < edges.size(); i++) {
+      order[row_end[std::get<0>(edges[i])]++] = i;
+    }
+
+    auto target_of = [&](EdgeIndex i) { return std::get<1>(edges[i]); };
+    for (auto v = size_t{0}; v < num_vertices; v++) {
+      auto row = std::ranges::subrange(order.begin() + offsets[v],
+                                       order.begin() + offsets[v + 1]);
+      std::ranges::stable_sort(row, {}, target_of);
+      assert(std::ranges::adjacent_find(row, {}, target_of) == row.end());
+    }
+
+    targets.reserve(edges.size());
+    payloads.reserve(edges.size());
+    for (auto i : order) {
+      targets.emplace_back(std::get<1>(edges[i]));
+      payloads.emplace_back(std::move(std::get<2>(edges[i])));
+    }
+  }
+
+  auto vertex(Vertex v) const -> std::optional<Vertex> {
+    if (v < num_vertices()) {
+      return v;
     } else {
       return std::nullopt;
     }
   }
 
-  auto add_edge(Vertex from, Vertex to, Edge e) -> const Edge & {
-    auto from_desc = vertex_map.left.at(from);
-    auto to_desc = vertex_map.left.at(to);
+  auto add_edge(Vertex from, Vertex to, Edge e) -> Edge & {
+    assert(from < num_vertices() && to < num_vertices());
+    assert(!edge_index(from, to));
+    assert(payloads.size() + 1 < no_edge);
+
+    if (overlay_head.empty()) {
+      overlay_head.assign(num_vertices(), no_edge);
+    }
+
+    auto index = static_cast<EdgeIndex>(payloads.size());
+    targets.emplace_back(to);
+    payloads.emplace_back(std::move(e));
+    overlay_sources.emplace_back(from);
+    overlay_next.emplace_back(overlay_head[from]);
+    overlay_head[from] = index;
 
-    auto [desc, _] = boost::add_edge(from_desc, to_desc, *graph);
-    return edge_map.try_emplace(desc, e).first->second;
+    return payloads.back();
+  }
+
+  auto edge_index(Vertex from, Vertex to) const -> std::optional<EdgeIndex> {
+    auto row_begin = targets.begin() + offsets[from];
+    auto row_end = targets.begin() + offsets[from + 1];
+    if (auto it = std::lower_bound(row_begin, row_end, to);
+        it != row_end && *it == to) {
+      return static_cast<EdgeIndex>(it - targets.begin());
+    }
+
+    if (!overlay_head.empty()) {
+      for (auto e = overlay_head[from]; e != no_edge;
+           e = overlay_next[e - offsets.back()]) {
+        if (targets[e] == to) {
+          return e;
+        }
+      }
+    }
+
+    return std::nullopt;
   }
 
   auto edge(Vertex from, Vertex to)
       -> std::optional<std::reference_wrapper<Edge>> {
-    if (auto r = std::as_const(*this).edge(from, to); r) {
-      return std::ref(const_cast<Edge &>(r.value().get()));
+    if (auto e = edge_index(from, to); e) {
+      return std::ref(payloads[*e]);
     } else {
       return std::nullopt;
     }
@@ -72,60 +142,242 @@ struct Graph {
 
   auto edge(Vertex from, Vertex to) const
       -> std::optional<std::reference_wrapper<const Edge>> {
-    auto from_desc = vertex_map.left.at(from);
-    auto to_desc = vertex_map.left.at(to);
-
-    if (auto [desc, has_edge] = boost::edge(from_desc, to_desc, *graph);
-        has_edge) {
-      return std::ref(edge_map.at(desc));
+    if (auto e = edge_index(from, to); e) {
+      return std::cref(payloads[*e]);
     } else {
       return std::nullopt;
     }
   }
 
+  auto source(EdgeIndex e) const -> Vertex {
+    if (e >= offsets.back()) {
+      return overlay_sources[e - offsets.back()];
+    }
+
+    auto it = std::upper_bound(offsets.begin(), offsets.end(), e);
+    return static_cast<Vertex>(it - offsets.begin() - 1);
+  }
+
+  auto target(EdgeIndex e) const -> Vertex { return targets[e]; }
+
+  auto payload(EdgeIndex e) const -> const Edge & { return payloads[e]; }
+
+  /*
+   * Indices of the out-edges of a vertex: its CSR row, then its overlay
+   * chain.
+   */
+  struct OutEdgeIterator {
+    using value_type = EdgeIndex;
+    using difference_type = std::ptrdiff_t;
+
+    const Graph *graph = nullptr;
+    EdgeIndex e = no_edge;
+    EdgeIndex row_end = no_edge;
+    Vertex v = 0;
+
+    auto operator*() const -> EdgeIndex { return e; }
+
+    auto operator++() -> OutEdgeIterator & {
+      if (e >= graph->offsets.back()) {
+        e = graph->overlay_next[e - graph->offsets.back()];
+      } else if (++e == row_end) {
+        e = graph->overlay_head.empty() ? no_edge : graph->overlay_head[v];
+      }
+      return *this;
+    }
+
+    auto operator++(int) -> OutEdgeIterator {
+      auto it = *this;
+      ++*this;
+      return it;
+    }
+
+    auto operator==(std::default_sentinel_t) const -> bool {
+      return e == no_edge;
+    }
+  };
+
+  auto out_edges(Vertex v) const -> std::ranges::range auto{
+    auto it = OutEdgeIterator{
+        .graph = this,
+        .e = offsets[v],
+        .row_end = offsets[v + 1],
+        .v = v,
+    };
+    if (it.e == it.row_end) {
+      it.e = overlay_head.empty() ? no_edge : overlay_head[v];
+    }
+
+    return std::ranges::subrange{it, std::default_sentinel};
+  }
+
   auto successors(Vertex vertex) const -> std::ranges::range auto{
-    auto [begin, end] = boost::out_edges(vertex_map.left.at(vertex), *graph);
-    return std::ranges::subrange(begin, end)  //
-           | std::ranges::views::transform([&](auto desc) -> decltype(auto) {
-               return vertex_map.right.at(boost::target(desc, *graph));
-             });
+    return out_edges(vertex)  //
+           | std::ranges::views::transform(
+                 [this](EdgeIndex e) { return targets[e]; });
   }
 
   auto vertices() const -> std::ranges::range auto{
-    auto [begin, end] = boost::vertices(*graph);
-    return std::ranges::subrange(begin, end)  //
-           | std::ranges::views::transform([&](auto desc) -> decltype(auto) {
-               return vertex_map.right.at(desc);
-             });
+    return std::ranges::views::iota(Vertex{0},
+                                    static_cast<Vertex>(num_vertices()));
   }
 
-  auto num_vertices() const -> ssize_t { return boost::num_vertices(*graph); }
+  auto num_vertices() const -> size_t { return offsets.size() - 1; }
 
-  auto num_edges() const -> ssize_t { return boost::num_edges(*graph); }
+  auto num_edges() const -> size_t { return payloads.size(); }
 
   auto edges() const -> std::ranges::range auto{
-    auto [begin, end] = boost::edges(*graph);
-    return std::ranges::subrange(begin, end)  //
-           | std::ranges::views::transform([&](auto desc) -> decltype(auto) {
-               return std::tuple{
-                   std::ref(vertex_map.right.at(boost::source(desc, *graph))),
-                   std::ref(vertex_map.right.at(boost::target(desc, *graph))),
-                   std::ref(edge_map.at(desc)),
-               };
+    return std::ranges::views::iota(EdgeIndex{0},
+                                    static_cast<EdgeIndex>(num_edges()))  //
+           | std::ranges::views::transform([this](EdgeIndex e) {
+               return std::tuple{source(e), targets[e], std::cref(payloads[e])};
              });
   }
 
+  /*
+   * Rebuild the rows with the overlay edges merged in, so that lookups are
+   * binary searches again. Invalidates edge indices.
+   */
+  auto compact() -> void {
+    if (overlay_sources.empty()) {
+      return;
+    }
+
+    auto edges = std::vector<std::tuple<Vertex, Vertex, Edge>>{};
+    edges.reserve(num_edges());
+    for (auto e = EdgeIndex{0}; e < num_edges(); e++) {
+      edges.emplace_back(source(e), targets[e], std::move(payloads[e]));
+    }
+
+    *this = Graph{num_vertices(), std::move(edges)};
+  }
+
   friend auto operator<<(std::ostream &os, const Graph &graph)
       -> std::ostream & {
     auto out = std::osyncstream{os};
 
     for (const auto &[from, to, e] : graph.edges()) {
-      out << from << "->" << to << ' ' << e << '\n';
+      out << from << "->" << to << ' ' << e.get() << '\n';
     }
 
     return os;
   }
 };
+
+/**
+ * Topological order of a graph over [0, n) whose out-neighbours are given by
+ * successors(v), by Kahn's algorithm. Returns nullopt if the graph has a
+ * cycle.
+ */
+template <typename Successors>
+auto topological_sort(size_t n, Successors &&successors)
+    -> std::optional<std::vector<uint32_t>> {
+  auto in_degree = std::vector<uint32_t>(n);
+  for (auto v = size_t{0}; v < n; v++) {
+    for (auto v2 : successors(v)) {
+      in_degree[v2]++;
+    }
+  }
+
+  auto order = std::vector<uint32_t>{};
+  order.reserve(n);
+  for (auto v = size_t{0}; v < n; v++) {
+    if (in_degree[v] == 0) {
+      order.emplace_back(v);
+    }
+  }
+  for (auto i = size_t{0}; i < order.size(); i++) {
+    for (auto v2 : successors(order[i])) {
+      if (--in_degree[v2] == 0) {
+        order.emplace_back(v2);
+      }
+    }
+  }
+
+  if (order.size() != n) {
+    return std::nullopt;
+  }
+  return order;
+}
+
+/**
+ * The strongly connected component of each vertex of a graph over [0, n)
+ * whose out-neighbours are given by successors(v), by Tarjan's algorithm.
+ * Components are numbered in reverse topological order, so every edge
+ * between two components goes to the one with the smaller number.
+ *
+ * The successors are copied once into flat arrays, so that the depth-first
+ * search is iterative and can resume a vertex's edges cheaply.
+ */
+template <typename Successors>
+auto strongly_connected_components(size_t n, Successors &&successors)
+    -> std::vector<uint32_t> {
+  constexpr auto none = std::numeric_limits<uint32_t>::max();
+
+  auto offsets = std::vector<uint32_t>{0};
+  auto targets = std::vector<uint32_t>{};
+  offsets.reserve(n + 1);
+  for (auto v = size_t{0}; v < n; v++) {
+    for (auto v2 : successors(v)) {
+      targets.emplace_back(v2);
+    }
+    offsets.emplace_back(targets.size());
+  }
+
+  // a vertex is on the stack iff it has an index but no component yet
+  auto index = std::vector<uint32_t>(n, none);
+  auto low = std::vector<uint32_t>(n);
+  auto component = std::vector<uint32_t>(n, none);
+  auto stack = std::vector<uint32_t>{};
+  auto frames = std::vector<std::pair<uint32_t, uint32_t>>{};  // (v, next)
+  auto n_visited = uint32_t{0};
+  auto n_components = uint32_t{0};
+
+  auto visit = [&](uint32_t v) {
+    index[v] = low[v] = n_visited++;
+    stack.emplace_back(v);
+    frames.emplace_back(v, offsets[v]);
+  };
+
+  for (auto root = uint32_t{0}; root < n; root++) {
+    if (index[root] != none) {
+      continue;
+    }
+
+    visit(root);
+    while (!frames.empty()) {
+      auto &[v, next] = frames.back();
+      if (next < offsets[v + 1]) {
+        auto v2 = targets[next++];
+        if (index[v2] == none) {
+          visit(v2);
+        } else if (component[v2] == none) {
+          low[v] = std::min(low[v], index[v2]);
+        }
+        continue;
+      }
+
+      auto done = v;
+      frames.pop_back();
+      if (low[done] == index[done]) {
+        auto v2 = none;
+        do {
+          v2 = stack.back();
+          stack.pop_back();
+          component[v2] = n_components;
+        } while (v2 != done);
+        n_components++;
+      }
+      if (!frames.empty()) {
+        auto parent = frames.back().first;
+        low[parent] = std::min(low[parent], low[done]);
+      }
+    }
+  }
+
+  return component;
+}
+
 }  // namespace checker::utils
 
 #endif  // CHECKER_UTILS_GRAPH_H
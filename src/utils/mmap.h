@@ -0,0 +1,86 @@
+#ifndef CHECKER_UTILS_MMAP_H
+#define CHECKER_UTILS_MMAP_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstddef>
+#include <filesystem>
+#include <span>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace checker::utils {
+
+/**
+ * A read-only, private memory mapping of a whole file.
+ *
+ * The mapping is released when the object is destroyed. Empty files are
+ * represented by an empty span, since mmap() rejects zero-length mappings.
+ */
+struct MappedFile {
+  std::byte *data = nullptr;
+  size_t size = 0;
+
+  explicit MappedFile(const std::filesystem::path &path) {
+    auto fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      std::ostringstream os;
+      os << "Cannot open file '" << path.string() << "'";
+      throw std::runtime_error{os.str()};
+    }
+
+    struct stat st {};
+    if (::fstat(fd, &st) < 0) {
+      ::close(fd);
+      std::ostringstream os;
+      os << "Cannot stat file '" << path.string() << "'";
+      throw std::runtime_error{os.str()};
+    }
+
+    size = static_cast<size_t>(st.st_size);
+    if (size != 0) {
+      auto p = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (p == MAP_FAILED) {
+        ::close(fd);
+        std::ostringstream os;
+        os << "Cannot mmap file '" << path.string() << "'";
+        throw std::runtime_error{os.str()};
+      }
+
+      data = static_cast<std::byte *>(p);
+      ::madvise(p, size, MADV_SEQUENTIAL);
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+  }
+
+  MappedFile(const MappedFile &) = delete;
+  auto operator=(const MappedFile &) -> MappedFile & = delete;
+
+  MappedFile(MappedFile &&other) noexcept
+      : data{std::exchange(other.data, nullptr)},
+        size{std::exchange(other.size, 0)} {}
+
+  auto operator=(MappedFile &&other) noexcept -> MappedFile & {
+    std::swap(data, other.data);
+    std::swap(size, other.size);
+    return *this;
+  }
+
+  auto bytes() const -> std::span<const std::byte> { return {data, size}; }
+
+  ~MappedFile() {
+    if (data) {
+      ::munmap(data, size);
+    }
+  }
+};
+
+}  // namespace checker::utils
+
+#endif  // CHECKER_UTILS_MMAP_H
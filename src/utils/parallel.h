@@ -0,0 +1,80 @@
+#ifndef CHECKER_UTILS_PARALLEL_H
+#define CHECKER_UTILS_PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace checker::utils {
+
+/**
+ * Number of worker threads to use when the caller does not specify one.
+ */
+inline auto default_concurrency() -> size_t {
+  return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/**
+ * Call f(i, worker) for every i in [0, n) on up to `threads` threads, where
+ * worker in [0, threads) identifies the calling thread, so callers can keep
+ * per-worker state in a vector indexed by it.
+ *
+ * Indices are handed out in chunks of `chunk` from a shared counter, so a
+ * worker that finishes early keeps taking work from the others. If f throws,
+ * the remaining indices are skipped and the first exception is rethrown on
+ * the calling thread.
+ */
+template <typename F>
+auto parallel_for(size_t n, size_t threads, F &&f, size_t chunk = 1) -> void {
+  threads = std::clamp<size_t>(threads, 1, std::max<size_t>(n, 1));
+  chunk = std::max<size_t>(chunk, 1);
+
+  if (threads == 1) {
+    for (auto i = size_t{0}; i < n; i++) {
+      f(i, size_t{0});
+    }
+    return;
+  }
+
+  auto next = std::atomic_size_t{0};
+  auto error = std::exception_ptr{};
+  auto error_mutex = std::mutex{};
+
+  auto work = [&](size_t worker) {
+    try {
+      for (auto begin = next.fetch_add(chunk); begin < n;
+           begin = next.fetch_add(chunk)) {
+        for (auto i = begin; i < std::min(begin + chunk, n); i++) {
+          f(i, worker);
+        }
+      }
+    } catch (...) {
+      next = n;
+      auto lock = std::lock_guard{error_mutex};
+      if (!error) {
+        error = std::current_exception();
+      }
+    }
+  };
+
+  {
+    auto workers = std::vector<std::jthread>{};
+    workers.reserve(threads - 1);
+    for (auto worker = size_t{1}; worker < threads; worker++) {
+      workers.emplace_back(work, worker);
+    }
+    work(0);
+  }
+
+  if (error) {
+    std::rethrow_exception(error);
+  }
+}
+
+}  // namespace checker::utils
+
+#endif  // CHECKER_UTILS_PARALLEL_H
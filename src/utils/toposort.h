@@ -1,28 +1,24 @@
 #ifndef CHECKER_UTILS_TOPOSORT_H
 #define CHECKER_UTILS_TOPOSORT_H
 
-#include <boost/graph/adjacency_list.hpp>
-#include <boost/graph/breadth_first_search.hpp>
-#include <boost/graph/filtered_graph.hpp>
-#include <boost/graph/reverse_graph.hpp>
-#include <boost/graph/topological_sort.hpp>
-#include <boost/graph/visitors.hpp>
+#include <algorithm>
 #include <boost/log/trivial.hpp>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
-#include <functional>
-#include <iterator>
+#include <cstdint>
 #include <limits>
-#include <memory>
 #include <optional>
-#include <queue>
 #include <ranges>
-#include <sstream>
+#include <span>
+#include <stdexcept>
+#include <string_view>
 #include <type_traits>
 #include <unordered_set>
 #include <utility>
 #include <vector>
 
+#include "utils/graph.h"
 #include "utils/literal.h"
 #include "utils/ranges.h"
 #include "utils/to_container.h"
@@ -51,23 +47,29 @@ struct TopologicalOrder {
     return pos_to_vertex.at(index);
   }
 
-  auto update_range(const std::vector<Vertex> &partial_order,
-                    size_t start_pos) {
+  /*
+   * Move vertices[i] to positions[i]. The positions must be those the
+   * vertices held before, in any order.
+   */
+  auto update(const std::vector<Vertex> &vertices,
+              const std::vector<size_t> &positions) -> void {
+    assert(vertices.size() == positions.size());
 #ifndef NDEBUG
     auto original_vertices =
-        std::ranges::views::counted(pos_to_vertex.begin() + start_pos,
-                                    partial_order.size()) |
+        positions |
+        std::ranges::views::transform([&](auto pos) {
+          return static_cast<size_t>(pos_to_vertex.at(pos));
+        }) |
         to<std::unordered_set<size_t>>;
 
-    auto new_vertices = partial_order | to<std::unordered_set<size_t>>;
+    auto new_vertices = vertices | to<std::unordered_set<size_t>>;
 
     assert(original_vertices == new_vertices);
 #endif
 
-    auto pos = start_pos;
-    for (const auto &v : partial_order) {
-      pos_to_vertex.at(pos) = v;
-      vertex_to_pos.at(v) = pos++;
+    for (auto i = 0_uz; i < vertices.size(); i++) {
+      pos_to_vertex.at(positions[i]) = vertices[i];
+      vertex_to_pos.at(vertices[i]) = positions[i];
     }
   }
 
@@ -76,161 +78,746 @@ struct TopologicalOrder {
   }
 };
 
+/**
+ * A total order over vertices [0, n) as a linked list with integer labels, so
+ * that comparing two vertices is comparing their labels and moving a vertex
+ * only relabels its neighbourhood when there is no gap left (Dietz and
+ * Sleator; relabelling as in Bender et al., "Two Simplified Algorithms for
+ * Maintaining Order in a List").
+ */
+template <typename Vertex>
+struct OrderList {
+  static_assert(std::is_integral_v<Vertex>);
+  static constexpr auto label_space = uint64_t{1} << 62;
+
+  // a sentinel with label 0 at index n closes the list into a ring
+  std::vector<uint64_t> labels;
+  std::vector<Vertex> next;
+  std::vector<Vertex> prev;
+
+  explicit OrderList(const std::ranges::range auto &vertices) {
+    auto order = std::vector<Vertex>{};
+    for (auto v : vertices) {
+      order.emplace_back(v);
+    }
+    auto n = order.size();
+    labels.resize(n + 1);
+    next.resize(n + 1);
+    prev.resize(n + 1);
+
+    auto spacing = label_space / (n + 1);
+    auto last = static_cast<Vertex>(n);
+    next[last] = prev[last] = last;
+    for (auto i = 0_uz; i < n; i++) {
+      labels[order[i]] = (i + 1) * spacing;
+      link_after(last, order[i]);
+      last = order[i];
+    }
+  }
+
+  auto sentinel() const -> Vertex {
+    return static_cast<Vertex>(labels.size() - 1);
+  }
+
+  auto before(Vertex a, Vertex b) const -> bool {
+    return labels[a] < labels[b];
+  }
+
+  auto label(Vertex v) const -> uint64_t { return labels[v]; }
+
+  /*
+   * Move v to right after `anchor`.
+   */
+  auto move_after(Vertex v, Vertex anchor) -> void {
+    assert(v != anchor);
+    next[prev[v]] = next[v];
+    prev[next[v]] = prev[v];
+    link_after(anchor, v);
+
+    auto high = next[v] == sentinel() ? label_space : labels[next[v]];
+    if (high - labels[anchor] >= 2) {
+      labels[v] = labels[anchor] + (high - labels[anchor]) / 2;
+    } else {
+      relabel_around(anchor);
+    }
+  }
+
+  auto vertices() const -> std::vector<Vertex> {
+    auto result = std::vector<Vertex>{};
+    for (auto v = next[sentinel()]; v != sentinel(); v = next[v]) {
+      result.emplace_back(v);
+    }
+    return result;
+  }
+
+ private:
+  auto link_after(Vertex anchor, Vertex v) -> void {
+    next[v] = next[anchor];
+    prev[v] = anchor;
+    prev[next[anchor]] = v;
+    next[anchor] = v;
+  }
+
+  /*
+   * Spread out the labels of the smallest aligned label range around
+   * `anchor` that is sparse enough, which includes the unlabelled vertex
+   * after it. A range of 2^i labels may hold up to (4/3)^i vertices.
+   */
+  auto relabel_around(Vertex anchor) -> void {
+    auto added = next[anchor];
+    for (auto i = 1; i <= 62; i++) {
+      auto width = uint64_t{1} << i;
+      auto base = labels[anchor] & ~(width - 1);
+      auto in_range = [&](Vertex v) {
+        return v != sentinel() && labels[v] >= base && labels[v] - base < width;
+      };
+
+      auto first = anchor;
+      auto count = 2_uz;
+      while (in_range(prev[first])) {
+        first = prev[first];
+        count++;
+      }
+      for (auto v = next[added]; in_range(v); v = next[v]) {
+        count++;
+      }
+
+      if (static_cast<double>(count) > std::pow(4.0 / 3.0, i)) {
+        continue;
+      }
+
+      auto spacing = width / (count + 1);
+      auto v = first;
+      for (auto j = 1_uz; j <= count; j++, v = next[v]) {
+        labels[v] = base + j * spacing;
+      }
+      return;
+    }
+
+    throw std::length_error{"too many vertices for OrderList"};
+  }
+};
+
+namespace detail {
+
+/*
+ * Visited marks stamped with the search they were set in, so that they never
+ * need to be cleared.
+ */
+struct SearchMarks {
+  std::vector<uint32_t> marks;
+  uint32_t stamp = 0;
+
+  explicit SearchMarks(size_t n) : marks(n) {}
+
+  auto next_stamp() -> uint32_t {
+    if (stamp == std::numeric_limits<uint32_t>::max()) {
+      std::ranges::fill(marks, 0);
+      stamp = 0;
+    }
+    return ++stamp;
+  }
+
+  auto mark(size_t v, uint32_t s) -> void { marks[v] = s; }
+
+  auto marked(size_t v, uint32_t s) const -> bool { return marks[v] == s; }
+};
+
+/*
+ * A topological order of the edges a graph already has when an algorithm is
+ * constructed. Throws std::invalid_argument if they form a cycle.
+ */
+template <typename Graph>
+auto initial_order(const Graph &graph) -> std::vector<uint32_t> {
+  auto order = topological_sort(num_vertices(graph), [&](auto v) {
+    return as_range(adjacent_vertices(v, graph));
+  });
+  if (!order) {
+    throw std::invalid_argument{"initial graph has a cycle"};
+  }
+  return std::move(*order);
+}
+
+/*
+ * The cycle closed by `added_edge` from->to, given a search tree rooted at
+ * `to` that reached `from`: the tree path to->from, then the added edge.
+ */
 template <typename Graph>
-struct IncrementalCycleDetector {
+auto tree_cycle(const Graph &graph,
+                const std::vector<typename Graph::edge_descriptor> &parent_edge,
+                const typename Graph::edge_descriptor &added_edge)
+    -> std::vector<typename Graph::edge_descriptor> {
+  auto from = source(added_edge, graph);
+  auto to = target(added_edge, graph);
+
+  auto cycle = std::vector{added_edge};
+  for (auto v = from; v != to; v = source(parent_edge[v], graph)) {
+    cycle.emplace_back(parent_edge[v]);
+  }
+
+  std::ranges::reverse(cycle);
+  return cycle;
+}
+
+}  // namespace detail
+
+/**
+ * Incremental cycle detection algorithms, the policies of
+ * IncrementalCycleDetector. Each is constructed from a graph modelling
+ * boost's BidirectionalGraph and AdjacencyGraph concepts, such as a
+ * boost::adjacency_list or a TrailGraph, and provides
+ *
+ *   check_add_edge(edge): called after `edge` has been added to the graph;
+ *     returns the edges of a cycle through it if there is one, leaving the
+ *     algorithm's state as it was
+ *   check_add_edges(edges), optionally: the same for a batch of edges added
+ *     together, returning one cycle
+ *   before(a, b): whether a is before b in the order the algorithm keeps, so
+ *     that an edge a->b would be checked without a search
+ *
+ * Without check_add_edges(), a batch is checked edge by edge, which is
+ * correct for OrderMaintenance and TwoWaySearch as their searches do not rely
+ * on edges yet to be checked being in order. Edges may be removed from the
+ * graph at any time, as the state of every algorithm stays valid for a
+ * subgraph.
+ *
+ * The graph may already have edges, e.g. a base layer that is never removed,
+ * as long as they form no cycle: every algorithm starts from a topological
+ * order of them, so that they never need reordering.
+ */
+
+/**
+ * Maintains a topological order in an array, by Pearce and Kelly's algorithm:
+ * http://www.doc.ic.ac.uk/%7Ephjk/Publications/DynamicTopoSortAlg-JEA-07.pdf
+ *
+ * Adding edges that go backwards in the order only looks at the affected
+ * region: the vertices reachable from their targets that are not after the
+ * last of their sources, and the vertices reaching their sources that are not
+ * before the first of their targets. These are reordered among their own
+ * positions, so the cost is proportional to the size of the region rather
+ * than that of the graph. A batch of edges is handled in one pass over the
+ * union of their regions. Cycles found are shortest ones through the first
+ * edge of the batch that is on a cycle.
+ */
+template <typename Graph>
+struct PearceKelly {
+  static constexpr auto name = std::string_view{"pearce-kelly"};
+
   using Vertex = typename Graph::vertex_descriptor;
   using Edge = typename Graph::edge_descriptor;
 
   Graph *graph;
   TopologicalOrder<typename Graph::vertex_descriptor> topo_order;
 
-  size_t n_bfs_called = 0;
-
-  explicit IncrementalCycleDetector(Graph &graph)
-      : graph{&graph}, topo_order{[&] {
-          auto [begin, end] = boost::vertices(graph);
-          return std::ranges::subrange(begin, end);
-        }()} {}
+  // scratch space
+  detail::SearchMarks forward_visited;
+  detail::SearchMarks backward_visited;
+  detail::SearchMarks cycle_visited;
+  std::vector<uint32_t> in_degree;
+  std::vector<Edge> parent_edge;  // edge a vertex was found through
+  std::vector<Edge> backward_edges;
+  std::vector<Vertex> forward;
+  std::vector<Vertex> backward;
+  std::vector<Vertex> both;
+  std::vector<Vertex> reordered;
+  std::vector<size_t> positions;
+
+  size_t n_searches = 0;
+  size_t n_vertices_visited = 0;
+
+  explicit PearceKelly(Graph &graph)
+      : graph{&graph},
+        topo_order{detail::initial_order(graph)},
+        forward_visited{num_vertices(graph)},
+        backward_visited{num_vertices(graph)},
+        cycle_visited{num_vertices(graph)},
+        in_degree(num_vertices(graph)),
+        parent_edge(num_vertices(graph)) {}
+
+  auto before(Vertex a, Vertex b) const -> bool {
+    return topo_order.vertex_pos(a) < topo_order.vertex_pos(b);
+  }
 
-  // ref:
-  // http://www.doc.ic.ac.uk/%7Ephjk/Publications/DynamicTopoSortAlg-JEA-07.pdf
   auto check_add_edge(const Edge &edge) -> std::optional<std::vector<Edge>> {
-    using boost::depth_first_search;
-    using boost::filtered_graph;
-    using boost::keep_all;
-    using boost::source;
-    using boost::target;
-    using std::back_inserter;
-    using std::function;
-    using std::greater;
-    using std::max;
-    using std::min;
-    using std::nullopt;
-    using std::numeric_limits;
-    using std::pair;
-    using std::vector;
-    using std::ranges::reverse;
-    using std::ranges::sort;
-    using std::ranges::subrange;
-    using std::ranges::views::iota;
-    using std::ranges::views::transform;
-
-    auto from_pos = topo_order.vertex_pos(source(edge, *graph));
-    auto to_pos = topo_order.vertex_pos(target(edge, *graph));
-    if (from_pos < to_pos) {
-      return nullopt;
-    }
-
-    auto filter_vertices = [&](Vertex vertex) {
-      auto pos = topo_order.vertex_pos(vertex);
-      return to_pos <= pos && pos <= from_pos;
-    };
+    return check_add_edges(std::span{&edge, 1});
+  }
 
-    auto partial_graph = filtered_graph{
-        *graph,
-        keep_all{},
-        function{filter_vertices},
+  /*
+   * Let F be the vertices reachable from the targets of the backward edges,
+   * and B those reaching their sources, both within the affected window. A
+   * cycle goes through some backward edge and lies in the window, so it lies
+   * in F and B. Otherwise, no edge leaves F for B - F or enters F & B from
+   * B - F, so B - F, then F & B sorted locally, then F - B is a topological
+   * order of the region. B - F and F - B keep their relative order, only
+   * moving towards the front and the back respectively, which keeps the
+   * edges leaving the region in order.
+   */
+  template <std::ranges::forward_range Edges>
+  auto check_add_edges(const Edges &edges) -> std::optional<std::vector<Edge>> {
+    auto lower = std::numeric_limits<size_t>::max();
+    auto upper = 0_uz;
+    backward_edges.clear();
+    for (const auto &e : edges) {
+      auto from_pos = topo_order.vertex_pos(source(e, *graph));
+      auto to_pos = topo_order.vertex_pos(target(e, *graph));
+      if (from_pos >= to_pos) {
+        backward_edges.emplace_back(e);
+        lower = std::min(lower, to_pos);
+        upper = std::max(upper, from_pos);
+      }
+    }
+    if (backward_edges.empty()) {
+      return std::nullopt;
+    }
+
+    n_searches++;
+    auto in_window = [&](Vertex v) {
+      auto pos = topo_order.vertex_pos(v);
+      return lower <= pos && pos <= upper;
     };
 
-    auto [partial_topo_order, cycle] = bfs_topo_sort(edge, partial_graph);
-    assert(!cycle.empty() || !partial_topo_order.empty());
-    if (!cycle.empty()) {
-      return {std::move(cycle)};
+    auto forward_mark = forward_visited.next_stamp();
+    forward.clear();
+    for (const auto &e : backward_edges) {
+      if (auto v = target(e, *graph);
+          !forward_visited.marked(v, forward_mark)) {
+        forward_visited.mark(v, forward_mark);
+        forward.emplace_back(v);
+      }
+    }
+    for (auto i = 0_uz; i < forward.size(); i++) {
+      for (auto &&e : as_range(out_edges(forward[i], *graph))) {
+        auto v2 = target(e, *graph);
+        if (!forward_visited.marked(v2, forward_mark) && in_window(v2)) {
+          forward_visited.mark(v2, forward_mark);
+          forward.emplace_back(v2);
+        }
+      }
     }
 
-    topo_order.update_range(partial_topo_order, to_pos);
-    return nullopt;
-  }
-
-  auto bfs_topo_sort(const Edge &added_edge, const auto &filtered_graph)
-      -> std::pair<std::vector<Vertex>, std::vector<Edge>> {
-    using boost::edge;
-    using boost::num_vertices;
-    using boost::out_edges;
-    using boost::source;
-    using boost::target;
-    using boost::vertices;
-    using std::numeric_limits;
-    using std::pair;
-    using std::queue;
-    using std::vector;
-    using std::ranges::find_if;
-    using std::ranges::reverse;
+    auto backward_mark = backward_visited.next_stamp();
+    backward.clear();
+    for (const auto &e : backward_edges) {
+      if (auto v = source(e, *graph);
+          !backward_visited.marked(v, backward_mark)) {
+        backward_visited.mark(v, backward_mark);
+        backward.emplace_back(v);
+      }
+    }
+    for (auto i = 0_uz; i < backward.size(); i++) {
+      for (auto &&e : as_range(in_edges(backward[i], *graph))) {
+        auto v2 = source(e, *graph);
+        if (!backward_visited.marked(v2, backward_mark) && in_window(v2)) {
+          backward_visited.mark(v2, backward_mark);
+          backward.emplace_back(v2);
+        }
+      }
+    }
+    n_vertices_visited += forward.size() + backward.size();
 
-    n_bfs_called++;
+    auto in_both = [&](Vertex v) {
+      return forward_visited.marked(v, forward_mark) &&
+             backward_visited.marked(v, backward_mark);
+    };
 
-    auto from = source(added_edge, filtered_graph);
-    auto to = target(added_edge, filtered_graph);
+    // split into B - F, F & B and F - B
+    both.clear();
+    std::erase_if(backward, [&](Vertex v) {
+      if (in_both(v)) {
+        both.emplace_back(v);
+        return true;
+      }
+      return false;
+    });
+    std::erase_if(forward, in_both);
+
+    auto by_pos = [&](Vertex v) { return topo_order.vertex_pos(v); };
+    std::ranges::sort(backward, {}, by_pos);
+    std::ranges::sort(forward, {}, by_pos);
+
+    // sort F & B by Kahn's algorithm; what is left over is on or after a
+    // cycle
+    reordered.clear();
+    reordered.insert(reordered.end(), backward.begin(), backward.end());
+    if (!both.empty()) {
+      for (auto v : both) {
+        in_degree[v] = 0;
+      }
+      for (auto v : both) {
+        for (auto v2 : as_range(adjacent_vertices(v, *graph))) {
+          if (in_both(v2)) {
+            in_degree[v2]++;
+          }
+        }
+      }
 
-    auto topo_order = vector<Vertex>{};
-    auto q = queue<Vertex>{};
-    auto in_degree = vector<size_t>(num_vertices(filtered_graph));
+      auto begin = reordered.size();
+      for (auto v : both) {
+        if (in_degree[v] == 0) {
+          reordered.emplace_back(v);
+        }
+      }
+      for (auto i = begin; i < reordered.size(); i++) {
+        for (auto v2 :
+             as_range(adjacent_vertices(reordered[i], *graph))) {
+          if (in_both(v2) && --in_degree[v2] == 0) {
+            reordered.emplace_back(v2);
+          }
+        }
+      }
 
-    for (auto &&v : as_range(vertices(filtered_graph))) {
-      for (auto &&e : as_range(out_edges(v, filtered_graph))) {
-        in_degree.at(target(e, filtered_graph))++;
+      if (reordered.size() - begin != both.size()) {
+        return shortest_cycle([&](Vertex v) {
+          return in_both(v) && in_degree[v] != 0;
+        });
       }
     }
-    for (auto &&v : as_range(vertices(filtered_graph))) {
-      if (!in_degree.at(v)) {
-        q.push(v);
-      }
+    reordered.insert(reordered.end(), forward.begin(), forward.end());
+
+    positions.clear();
+    for (auto v : reordered) {
+      positions.emplace_back(by_pos(v));
     }
+    std::ranges::sort(positions);
 
-    while (!q.empty()) {
-      auto v = q.front();
-      q.pop();
-      topo_order.emplace_back(v);
+    topo_order.update(reordered, positions);
+    return std::nullopt;
+  }
+
+ private:
+  /*
+   * A shortest cycle through the first backward edge that is on one, by a
+   * BFS over the vertices that may be on a cycle.
+   */
+  template <typename OnCycle>
+  auto shortest_cycle(OnCycle &&may_be_on_cycle) -> std::vector<Edge> {
+    for (const auto &edge : backward_edges) {
+      auto from = source(edge, *graph);
+      auto to = target(edge, *graph);
+      if (!may_be_on_cycle(from) || !may_be_on_cycle(to)) {
+        continue;
+      }
 
-      for (auto &&e : as_range(out_edges(v, filtered_graph))) {
-        auto v2 = target(e, filtered_graph);
+      auto mark = cycle_visited.next_stamp();
+      forward.clear();
+      forward.emplace_back(to);
+      cycle_visited.mark(to, mark);
+      for (auto i = 0_uz; i < forward.size(); i++) {
+        auto v = forward[i];
+        if (v == from) {
+          return detail::tree_cycle(*graph, parent_edge, edge);
+        }
 
-        if (!--in_degree.at(v2)) {
-          q.push(v2);
+        for (auto &&e : as_range(out_edges(v, *graph))) {
+          auto v2 = target(e, *graph);
+          if (!cycle_visited.marked(v2, mark) && may_be_on_cycle(v2)) {
+            cycle_visited.mark(v2, mark);
+            parent_edge[v2] = e;
+            forward.emplace_back(v2);
+          }
         }
       }
     }
 
-    if (find_if(in_degree, [](auto n) { return n != 0; }) == in_degree.end()) {
-      return pair{std::move(topo_order), vector<Edge>{}};
+    assert(false);
+    return {};
+  }
+};
+
+/**
+ * Maintains a topological order in an OrderList. For an edge from->to that
+ * goes backwards, a BFS forward from `to` collects the vertices not after
+ * `from`, which are then moved, in order, to right after `from`. Only that
+ * set is searched and relabelled; nothing else moves. Cycles found are
+ * shortest ones.
+ */
+template <typename Graph>
+struct OrderMaintenance {
+  static constexpr auto name = std::string_view{"order-maintenance"};
+
+  using Vertex = typename Graph::vertex_descriptor;
+  using Edge = typename Graph::edge_descriptor;
+
+  Graph *graph;
+  OrderList<Vertex> order;
+
+  // scratch space
+  detail::SearchMarks visited;
+  std::vector<Edge> parent_edge;
+  std::vector<Vertex> forward;
+
+  size_t n_searches = 0;
+  size_t n_vertices_visited = 0;
+
+  explicit OrderMaintenance(Graph &graph)
+      : graph{&graph},
+        order{detail::initial_order(graph)},
+        visited{num_vertices(graph)},
+        parent_edge(num_vertices(graph)) {}
+
+  auto before(Vertex a, Vertex b) const -> bool { return order.before(a, b); }
+
+  auto check_add_edge(const Edge &edge) -> std::optional<std::vector<Edge>> {
+    auto from = source(edge, *graph);
+    auto to = target(edge, *graph);
+    if (order.before(from, to)) {
+      return std::nullopt;
     }
 
-    auto predecessor = vector<Vertex>(num_vertices(filtered_graph),
-                                      numeric_limits<Vertex>::max());
-    q.push(to);
-    while (true) {
-      assert(!q.empty());
-      auto v = q.front();
-      q.pop();
+    n_searches++;
+    auto mark = visited.next_stamp();
 
+    forward.clear();
+    forward.emplace_back(to);
+    visited.mark(to, mark);
+    for (auto i = 0_uz; i < forward.size(); i++) {
+      auto v = forward[i];
       if (v == from) {
-        break;
+        return detail::tree_cycle(*graph, parent_edge, edge);
+      }
+
+      for (auto &&e : as_range(out_edges(v, *graph))) {
+        auto v2 = target(e, *graph);
+        if (!visited.marked(v2, mark) && !order.before(from, v2)) {
+          visited.mark(v2, mark);
+          parent_edge[v2] = e;
+          forward.emplace_back(v2);
+        }
       }
+    }
+    n_vertices_visited += forward.size();
+
+    // everything after `from` was after the moved vertices already, and
+    // nothing they reach is before `from` any more
+    std::ranges::sort(forward, {}, [&](Vertex v) { return order.label(v); });
+    for (auto v : forward | std::ranges::views::reverse) {
+      order.move_after(v, from);
+    }
 
-      for (auto &&e : as_range(out_edges(v, filtered_graph))) {
-        auto v2 = target(e, filtered_graph);
-        if (predecessor.at(v2) != numeric_limits<Vertex>::max()) {
+    return std::nullopt;
+  }
+};
+
+/**
+ * Two-way search in the style of Bender, Fineman, Gilbert and Tarjan, "A New
+ * Approach to Incremental Cycle Detection and Related Problems" (sparse
+ * algorithm). Instead of an order it keeps a level per vertex, with
+ * level(x) <= level(y) for every edge x->y.
+ *
+ * For an edge v->w with level(v) >= level(w), a backward search from v over
+ * edges within v's level runs for at most sqrt(m) edges. If it finishes
+ * without meeting w, w is lifted to v's level; otherwise w is lifted one
+ * level above v. A forward search from w then lifts the vertices below their
+ * predecessors, and finds a cycle if it meets v or a vertex of the completed
+ * backward search. Unlike the paper, same-level in-edges are found by
+ * filtering in_edges() rather than kept in separate lists.
+ */
+template <typename Graph>
+struct TwoWaySearch {
+  static constexpr auto name = std::string_view{"two-way-search"};
+
+  using Vertex = typename Graph::vertex_descriptor;
+  using Edge = typename Graph::edge_descriptor;
+
+  Graph *graph;
+  std::vector<uint32_t> levels;
+
+  // scratch space
+  detail::SearchMarks visited;
+  std::vector<Edge> parent_edge;  // forward search tree
+  std::vector<Edge> child_edge;   // backward search tree
+  std::vector<Vertex> backward;
+  std::vector<Vertex> stack;
+  std::vector<std::pair<Vertex, uint32_t>> trail;  // levels to restore
+
+  size_t n_searches = 0;
+  size_t n_vertices_visited = 0;
+
+  explicit TwoWaySearch(Graph &graph)
+      : graph{&graph},
+        levels(num_vertices(graph)),
+        visited{num_vertices(graph)},
+        parent_edge(num_vertices(graph)),
+        child_edge(num_vertices(graph)) {
+    // the initial edges all go up a level
+    for (auto v : detail::initial_order(graph)) {
+      for (auto w : as_range(adjacent_vertices(v, graph))) {
+        levels[w] = std::max(levels[w], levels[v] + 1);
+      }
+    }
+  }
+
+  auto before(Vertex a, Vertex b) const -> bool {
+    return levels[a] < levels[b];
+  }
+
+  auto check_add_edge(const Edge &edge) -> std::optional<std::vector<Edge>> {
+    auto v = source(edge, *graph);
+    auto w = target(edge, *graph);
+    if (v == w) {
+      return std::vector{edge};
+    }
+    if (levels[v] < levels[w]) {
+      return std::nullopt;
+    }
+
+    n_searches++;
+    trail.clear();
+
+    // backward search within v's level, for at most delta edges
+    auto delta = std::max<size_t>(
+        1, static_cast<size_t>(std::sqrt(num_edges(*graph))));
+    auto mark = visited.next_stamp();
+    auto n_edges = 0_uz;
+    auto completed = true;
+
+    backward.clear();
+    backward.emplace_back(v);
+    visited.mark(v, mark);
+    for (auto i = 0_uz; i < backward.size() && completed; i++) {
+      for (auto &&e : as_range(in_edges(backward[i], *graph))) {
+        auto x = source(e, *graph);
+        if (levels[x] != levels[v]) {
           continue;
         }
+        if (x == w) {
+          child_edge[x] = e;
+          return backward_cycle(edge);
+        }
+        if (!visited.marked(x, mark)) {
+          visited.mark(x, mark);
+          child_edge[x] = e;
+          backward.emplace_back(x);
+        }
+        if (++n_edges == delta) {
+          completed = false;
+          break;
+        }
+      }
+    }
+    n_vertices_visited += backward.size();
 
-        predecessor.at(v2) = v;
-        q.push(v2);
+    if (completed) {
+      if (levels[w] == levels[v]) {
+        return std::nullopt;
       }
+      lift(w, levels[v]);
+    } else {
+      lift(w, levels[v] + 1);
     }
 
-    auto cycle = vector{added_edge};
-    for (auto v = from; v != to; v = predecessor.at(v)) {
-      auto [e, has_edge] = edge(predecessor.at(v), v, filtered_graph);
-      assert(has_edge);
-      cycle.emplace_back(e);
+    // what the backward search found reaches v; if it stopped early, only v
+    // itself is known to
+    auto in_backward = [&](Vertex x) {
+      return x == v || (completed && visited.marked(x, mark));
+    };
+
+    stack.clear();
+    stack.emplace_back(w);
+    while (!stack.empty()) {
+      auto x = stack.back();
+      stack.pop_back();
+      n_vertices_visited++;
+
+      for (auto &&e : as_range(out_edges(x, *graph))) {
+        auto y = target(e, *graph);
+        if (in_backward(y)) {
+          auto cycle = forward_cycle(edge, e);
+          for (auto [u, level] : trail | std::ranges::views::reverse) {
+            levels[u] = level;
+          }
+          return cycle;
+        }
+        if (levels[y] < levels[x]) {
+          lift(y, levels[x]);
+          parent_edge[y] = e;
+          stack.emplace_back(y);
+        }
+      }
     }
 
-    reverse(cycle);
-    return pair{vector<Vertex>{}, std::move(cycle)};
+    return std::nullopt;
+  }
+
+ private:
+  auto lift(Vertex x, uint32_t level) -> void {
+    trail.emplace_back(x, levels[x]);
+    levels[x] = level;
+  }
+
+  /*
+   * w ... v in the backward search tree, then v->w.
+   */
+  auto backward_cycle(const Edge &added_edge) -> std::vector<Edge> {
+    auto v = source(added_edge, *graph);
+    auto w = target(added_edge, *graph);
+
+    auto cycle = std::vector<Edge>{};
+    for (auto x = w; x != v; x = target(child_edge[x], *graph)) {
+      cycle.emplace_back(child_edge[x]);
+    }
+    cycle.emplace_back(added_edge);
+    return cycle;
+  }
+
+  /*
+   * w ... x in the forward search tree, x->y, y ... v in the backward search
+   * tree, then v->w.
+   */
+  auto forward_cycle(const Edge &added_edge, const Edge &meeting_edge)
+      -> std::vector<Edge> {
+    auto v = source(added_edge, *graph);
+    auto w = target(added_edge, *graph);
+
+    auto cycle = std::vector<Edge>{};
+    for (auto x = source(meeting_edge, *graph); x != w;
+         x = source(parent_edge[x], *graph)) {
+      cycle.emplace_back(parent_edge[x]);
+    }
+    std::ranges::reverse(cycle);
+
+    cycle.emplace_back(meeting_edge);
+    for (auto y = target(meeting_edge, *graph); y != v;
+         y = target(child_edge[y], *graph)) {
+      cycle.emplace_back(child_edge[y]);
+    }
+    cycle.emplace_back(added_edge);
+    return cycle;
+  }
+};
+
+/**
+ * Incremental cycle detection over a bidirectional graph, with the
+ * algorithm as a policy: PearceKelly, OrderMaintenance or TwoWaySearch.
+ */
+template <typename Graph, typename Algorithm = PearceKelly<Graph>>
+struct IncrementalCycleDetector : Algorithm {
+  using Edge = typename Graph::edge_descriptor;
+
+  explicit IncrementalCycleDetector(Graph &graph) : Algorithm{graph} {}
+
+  /*
+   * Called after all of `edges` have been added to the graph. Returns the
+   * edges of a cycle if there is one.
+   */
+  template <std::ranges::forward_range Edges>
+  auto check_add_edges(const Edges &edges) -> std::optional<std::vector<Edge>> {
+    if constexpr (requires(Algorithm &a) { a.check_add_edges(edges); }) {
+      return Algorithm::check_add_edges(edges);
+    } else {
+      for (const auto &e : edges) {
+        if (auto cycle = Algorithm::check_add_edge(e); cycle) {
+          return cycle;
+        }
+      }
+      return std::nullopt;
+    }
   }
 
   ~IncrementalCycleDetector() {
-    BOOST_LOG_TRIVIAL(debug) << "bfs() called " << n_bfs_called << " times";
+    BOOST_LOG_TRIVIAL(debug)
+        << Algorithm::name << ": #cycle searches: " << Algorithm::n_searches
+        << ", #vertices visited: " << Algorithm::n_vertices_visited;
   }
 };
 
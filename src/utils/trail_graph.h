@@ -0,0 +1,161 @@
+#ifndef CHECKER_UTILS_TRAIL_GRAPH_H
+#define CHECKER_UTILS_TRAIL_GRAPH_H
+
+#include <cassert>
+#include <concepts>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <numeric>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+namespace checker::utils {
+
+/**
+ * A directed multigraph whose edges are added and removed in stack order, as
+ * a backtracking search does. Edge i is the i-th edge on the stack, so
+ * undoing to a previous state is truncating the stack to its old size.
+ *
+ * The edges that may be present at the same time are given up front, and
+ * each vertex gets fixed slots for them in an out-edge and an in-edge array,
+ * so add_edge() and remove_last_edge() are O(1) and never allocate.
+ *
+ * It models the parts of boost's BidirectionalGraph and AdjacencyGraph
+ * concepts the incremental cycle detectors in toposort.h use, as free
+ * functions found by argument dependent lookup.
+ */
+template <std::unsigned_integral Vertex, typename Edge>
+struct TrailGraph {
+  using EdgeIndex = uint32_t;
+  using vertex_descriptor = Vertex;
+  using edge_descriptor = EdgeIndex;
+
+  // the out-edges of v are out_slots[out_offsets[v]..][..out_size[v]], and
+  // out_slot_targets holds their targets at the same indices; likewise for
+  // in-edges
+  std::vector<EdgeIndex> out_offsets;
+  std::vector<EdgeIndex> out_size;
+  std::vector<EdgeIndex> out_slots;
+  std::vector<Vertex> out_slot_targets;
+  std::vector<EdgeIndex> in_offsets;
+  std::vector<EdgeIndex> in_size;
+  std::vector<EdgeIndex> in_slots;
+
+  std::vector<Vertex> sources;
+  std::vector<Vertex> targets;
+  std::vector<Edge> payloads;
+
+  /*
+   * `capacity` is a range of (from, to) pairs, each an edge that may be
+   * present at the same time as the others; an edge that may be present
+   * twice is given twice.
+   */
+  TrailGraph(size_t num_vertices, const std::ranges::range auto &capacity)
+      : out_offsets(num_vertices + 1),
+        out_size(num_vertices),
+        in_offsets(num_vertices + 1),
+        in_size(num_vertices) {
+    for (const auto &[from, to] : capacity) {
+      out_offsets.at(from + 1)++;
+      in_offsets.at(to + 1)++;
+    }
+    std::partial_sum(out_offsets.begin(), out_offsets.end(),
+                     out_offsets.begin());
+    std::partial_sum(in_offsets.begin(), in_offsets.end(), in_offsets.begin());
+
+    auto max_edges = out_offsets.back();
+    assert(max_edges < std::numeric_limits<EdgeIndex>::max());
+    out_slots.resize(max_edges);
+    out_slot_targets.resize(max_edges);
+    in_slots.resize(max_edges);
+    sources.reserve(max_edges);
+    targets.reserve(max_edges);
+    payloads.reserve(max_edges);
+  }
+
+  auto add_edge(Vertex from, Vertex to, Edge e) -> EdgeIndex {
+    assert(out_offsets[from] + out_size[from] < out_offsets[from + 1]);
+    assert(in_offsets[to] + in_size[to] < in_offsets[to + 1]);
+
+    auto index = static_cast<EdgeIndex>(payloads.size());
+    sources.emplace_back(from);
+    targets.emplace_back(to);
+    payloads.emplace_back(std::move(e));
+
+    auto out_slot = out_offsets[from] + out_size[from]++;
+    out_slots[out_slot] = index;
+    out_slot_targets[out_slot] = to;
+    in_slots[in_offsets[to] + in_size[to]++] = index;
+
+    return index;
+  }
+
+  /*
+   * The edges of a vertex are added in stack order too, so the last edge is
+   * the last slot of both of its endpoints.
+   */
+  auto remove_last_edge() -> void {
+    assert(!payloads.empty());
+    out_size[sources.back()]--;
+    in_size[targets.back()]--;
+    sources.pop_back();
+    targets.pop_back();
+    payloads.pop_back();
+  }
+
+  auto truncate(size_t num_edges) -> void {
+    while (payloads.size() > num_edges) {
+      remove_last_edge();
+    }
+  }
+
+  auto operator[](EdgeIndex e) -> Edge & { return payloads[e]; }
+
+  auto operator[](EdgeIndex e) const -> const Edge & { return payloads[e]; }
+
+  friend auto source(EdgeIndex e, const TrailGraph &graph) -> Vertex {
+    return graph.sources[e];
+  }
+
+  friend auto target(EdgeIndex e, const TrailGraph &graph) -> Vertex {
+    return graph.targets[e];
+  }
+
+  friend auto num_vertices(const TrailGraph &graph) -> size_t {
+    return graph.out_size.size();
+  }
+
+  friend auto num_edges(const TrailGraph &graph) -> size_t {
+    return graph.payloads.size();
+  }
+
+  friend auto vertices(const TrailGraph &graph) {
+    auto all = std::ranges::views::iota(
+        Vertex{0}, static_cast<Vertex>(num_vertices(graph)));
+    return std::pair{all.begin(), all.end()};
+  }
+
+  friend auto out_edges(Vertex v, const TrailGraph &graph)
+      -> std::pair<const EdgeIndex *, const EdgeIndex *> {
+    const auto *begin = graph.out_slots.data() + graph.out_offsets[v];
+    return {begin, begin + graph.out_size[v]};
+  }
+
+  friend auto in_edges(Vertex v, const TrailGraph &graph)
+      -> std::pair<const EdgeIndex *, const EdgeIndex *> {
+    const auto *begin = graph.in_slots.data() + graph.in_offsets[v];
+    return {begin, begin + graph.in_size[v]};
+  }
+
+  friend auto adjacent_vertices(Vertex v, const TrailGraph &graph)
+      -> std::pair<const Vertex *, const Vertex *> {
+    const auto *begin = graph.out_slot_targets.data() + graph.out_offsets[v];
+    return {begin, begin + graph.out_size[v]};
+  }
+};
+
+}  // namespace checker::utils
+
+#endif  // CHECKER_UTILS_TRAIL_GRAPH_H